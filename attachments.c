@@ -5,15 +5,17 @@
 #include "plugin.h"
 
 girara_list_t*
-pdf_document_attachments_get(zathura_document_t* document, PopplerDocument* poppler_document, zathura_error_t* error)
+pdf_document_attachments_get(zathura_document_t* document, pdf_document_t* pdf_document, zathura_error_t* error)
 {
-  if (document == NULL || poppler_document == NULL) {
+  if (document == NULL || pdf_document == NULL) {
     if (error != NULL) {
       *error = ZATHURA_ERROR_INVALID_ARGUMENTS;
     }
     return NULL;
   }
 
+  PopplerDocument* poppler_document = pdf_document->poppler_document;
+
   if (poppler_document_has_attachments(poppler_document) == FALSE) {
     girara_warning("PDF file has no attachments");
     if (error != NULL) {
@@ -42,12 +44,14 @@ pdf_document_attachments_get(zathura_document_t* document, PopplerDocument* popp
 
 zathura_error_t
 pdf_document_attachment_save(zathura_document_t* document,
-    PopplerDocument* poppler_document, const char* attachmentname, const char* file)
+    pdf_document_t* pdf_document, const char* attachmentname, const char* file)
 {
-  if (document == NULL || poppler_document == NULL) {
+  if (document == NULL || pdf_document == NULL) {
     return ZATHURA_ERROR_INVALID_ARGUMENTS;
   }
 
+  PopplerDocument* poppler_document = pdf_document->poppler_document;
+
   if (poppler_document_has_attachments(poppler_document) == FALSE) {
     girara_warning("PDF file has no attachments");
     return ZATHURA_ERROR_INVALID_ARGUMENTS;
@@ -0,0 +1,444 @@
+/* See LICENSE file for license and copyright information */
+
+/* Drives the plugin from several threads at once, the way a host rendering
+ * pages on worker threads while searching and selecting text does. Every run
+ * opens the document, performs a fixed number of operations spread over the
+ * threads and closes it again. Built with ThreadSanitizer by the stress
+ * target to find data races, without it by the benchmark target to measure
+ * how throughput scales with the number of threads.
+ *
+ * With --profiles, the render times of the render profiles are compared
+ * instead, with --render-cache rendering pages is compared with compressing
+ * and decompressing them for the render cache. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "zathura.h"
+#include "../rendercache.h"
+
+/* Every round over the document renders at another scale, so pages are
+ * rendered instead of painted from the page cache. */
+static const double scales[] = { 1.0, 1.25, 1.5, 2.0 };
+
+/* Out of this many operations, one searches, one loads the links, one
+ * extracts the text of a page and the others render pages */
+#define OPERATION_CYCLE  8
+#define OPERATION_SEARCH 5
+#define OPERATION_LINKS  6
+#define OPERATION_TEXT   7
+
+/**
+ * State shared by the threads of a run
+ */
+typedef struct run_s {
+  zathura_plugin_functions_t* functions; /**< Functions of the plugin */
+  zathura_document_t* document; /**< The document */
+  unsigned int operations; /**< Number of operations to perform */
+  bool render_only; /**< Set to only render pages */
+  const char* search_term; /**< Term searched for */
+  gint next; /**< Index of the next operation */
+  gint failures; /**< Number of failed operations */
+} run_t;
+
+static char* search_term     = "the";
+static gint max_threads      = 0;
+static gint operations       = 0;
+static gboolean render_only  = FALSE;
+static gboolean profiles     = FALSE;
+static gboolean render_cache = FALSE;
+
+static const char* profile_names[] = {
+  [PDF_RENDER_PROFILE_FINAL]       = "final",
+  [PDF_RENDER_PROFILE_INTERACTIVE] = "interactive"
+};
+
+static GOptionEntry entries[] = {
+  { "threads", 't', 0, G_OPTION_ARG_INT, &max_threads, "Maximum number of threads (default: number of processors)", "N" },
+  { "operations", 'n', 0, G_OPTION_ARG_INT, &operations, "Operations per run (default: 8 per page, at least 64)", "N" },
+  { "search", 's', 0, G_OPTION_ARG_STRING, &search_term, "Term to search for (default: \"the\")", "TERM" },
+  { "render-only", 'r', 0, G_OPTION_ARG_NONE, &render_only, "Only render pages", NULL },
+  { "profiles", 'p', 0, G_OPTION_ARG_NONE, &profiles, "Compare the render times of the render profiles", NULL },
+  { "render-cache", 'c', 0, G_OPTION_ARG_NONE, &render_cache, "Compare rendering pages with decompressing them from the render cache", NULL },
+  { NULL }
+};
+
+void register_functions(zathura_plugin_functions_t* functions);
+
+static zathura_document_t* document_open(zathura_plugin_functions_t*
+    functions, const char* path);
+static void document_close(zathura_plugin_functions_t* functions,
+    zathura_document_t* document);
+static cairo_t* create_target(zathura_page_t* page, double scale);
+static bool render(zathura_plugin_functions_t* functions, zathura_page_t*
+    page, double scale);
+static int compare_times(const void* a, const void* b);
+static bool benchmark_profiles(zathura_plugin_functions_t* functions, const
+    char* path);
+static bool benchmark_render_cache(zathura_plugin_functions_t* functions,
+    const char* path);
+static bool perform(run_t* run, unsigned int operation);
+static gpointer worker(gpointer data);
+static double run_threads(zathura_plugin_functions_t* functions, const char*
+    path, unsigned int threads, unsigned int* failures);
+
+int
+main(int argc, char* argv[])
+{
+  GError* error            = NULL;
+  GOptionContext* context  = g_option_context_new("FILE");
+  g_option_context_add_main_entries(context, entries, NULL);
+  g_option_context_set_summary(context, "Stress test and thread scaling benchmark of the PDF plugin");
+
+  if (g_option_context_parse(context, &argc, &argv, &error) == FALSE || argc != 2) {
+    fprintf(stderr, "%s\n", error != NULL ? error->message : "Exactly one file is required");
+    g_clear_error(&error);
+    g_option_context_free(context);
+    return EXIT_FAILURE;
+  }
+  g_option_context_free(context);
+
+  zathura_plugin_functions_t functions = { 0 };
+  register_functions(&functions);
+
+  zathura_document_t* document = document_open(&functions, argv[1]);
+  if (document == NULL) {
+    fprintf(stderr, "Failed to open %s\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+  const unsigned int number_of_pages = document->number_of_pages;
+  document_close(&functions, document);
+
+  if (max_threads <= 0) {
+    max_threads = g_get_num_processors();
+  }
+  if (operations <= 0) {
+    operations = MAX(OPERATION_CYCLE * number_of_pages, 64);
+  }
+
+  if (profiles == TRUE) {
+    printf("%s: %u pages, %d renders per profile\n\n", argv[1],
+        number_of_pages, operations);
+    return benchmark_profiles(&functions, argv[1]) == true ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  if (render_cache == TRUE) {
+    /* every page is rendered once per scale, later rounds would be painted
+     * from the page cache */
+    operations = MIN((unsigned int) operations, number_of_pages * G_N_ELEMENTS(scales));
+    printf("%s: %u pages, %d renders\n\n", argv[1], number_of_pages, operations);
+    return benchmark_render_cache(&functions, argv[1]) == true ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  printf("%s: %u pages, %d operations per run%s\n\n", argv[1], number_of_pages,
+      operations, render_only == TRUE ? ", rendering only" : "");
+  printf("%8s %12s %10s %10s %9s\n", "threads", "ops/s", "speedup",
+      "efficiency", "failures");
+
+  /* 1, 2, 4, ... threads and the maximum */
+  unsigned int total_failures = 0;
+  double baseline             = 0;
+  for (unsigned int threads = 1; threads <= (unsigned int) max_threads;
+      threads = threads < (unsigned int) max_threads ?
+      MIN(threads * 2, (unsigned int) max_threads) : threads + 1) {
+    unsigned int failures = 0;
+    const double throughput = run_threads(&functions, argv[1], threads, &failures);
+    if (threads == 1) {
+      baseline = throughput;
+    }
+
+    printf("%8u %12.1f %9.2fx %9.0f%% %9u\n", threads, throughput,
+        throughput / baseline, 100.0 * throughput / baseline / threads, failures);
+    total_failures += failures;
+  }
+
+  return total_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static zathura_document_t*
+document_open(zathura_plugin_functions_t* functions, const char* path)
+{
+  zathura_document_t* document = bench_document_new(path, NULL);
+
+  if (functions->document_open(document) != ZATHURA_ERROR_OK) {
+    bench_document_free(document);
+    return NULL;
+  }
+
+  for (unsigned int i = 0; i < document->number_of_pages; i++) {
+    if (functions->page_init(document->pages[i]) != ZATHURA_ERROR_OK) {
+      document_close(functions, document);
+      return NULL;
+    }
+  }
+
+  return document;
+}
+
+static void
+document_close(zathura_plugin_functions_t* functions, zathura_document_t*
+    document)
+{
+  for (unsigned int i = 0; i < document->number_of_pages; i++) {
+    zathura_page_t* page = document->pages[i];
+    if (page->data != NULL) {
+      functions->page_clear(page, page->data);
+      page->data = NULL;
+    }
+  }
+
+  functions->document_free(document, document->data);
+  bench_document_free(document);
+}
+
+static cairo_t*
+create_target(zathura_page_t* page, double scale)
+{
+  cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24,
+      ceil(page->width * scale), ceil(page->height * scale));
+  cairo_t* cairo = cairo_create(surface);
+  cairo_surface_destroy(surface);
+
+  /* zathura paints the background of the page itself */
+  cairo_set_source_rgb(cairo, 1, 1, 1);
+  cairo_paint(cairo);
+  cairo_scale(cairo, scale, scale);
+
+  return cairo;
+}
+
+static bool
+render(zathura_plugin_functions_t* functions, zathura_page_t* page, double scale)
+{
+  cairo_t* cairo = create_target(page, scale);
+  const zathura_error_t error = functions->page_render_cairo(page, page->data,
+      cairo, false);
+  cairo_destroy(cairo);
+
+  return error == ZATHURA_ERROR_OK;
+}
+
+static int
+compare_times(const void* a, const void* b)
+{
+  const gint64 time_a = *(const gint64*) a;
+  const gint64 time_b = *(const gint64*) b;
+
+  return (time_a > time_b) - (time_a < time_b);
+}
+
+static bool
+benchmark_profiles(zathura_plugin_functions_t* functions, const char* path)
+{
+  printf("%12s %10s %10s %10s %9s\n", "profile", "mean ms", "median ms",
+      "max ms", "failures");
+
+  gint64* times = g_malloc(sizeof(gint64) * operations);
+  bool success  = true;
+
+  for (unsigned int profile = 0; profile < G_N_ELEMENTS(profile_names); profile++) {
+    zathura_document_t* document = document_open(functions, path);
+    if (document == NULL) {
+      success = false;
+      break;
+    }
+
+    unsigned int failures = 0;
+    gint64 total          = 0;
+    for (unsigned int i = 0; i < (unsigned int) operations; i++) {
+      zathura_page_t* page = document->pages[i % document->number_of_pages];
+      const unsigned int round = i / document->number_of_pages;
+      cairo_t* cairo = create_target(page, scales[round % G_N_ELEMENTS(scales)]);
+
+      const gint64 start = g_get_monotonic_time();
+      if (pdf_page_render_cairo_with_profile(page, page->data, cairo, profile)
+          != ZATHURA_ERROR_OK) {
+        failures++;
+      }
+      times[i] = g_get_monotonic_time() - start;
+      total   += times[i];
+
+      cairo_destroy(cairo);
+    }
+
+    document_close(functions, document);
+
+    qsort(times, operations, sizeof(gint64), compare_times);
+    printf("%12s %10.2f %10.2f %10.2f %9u\n", profile_names[profile],
+        total / 1000.0 / operations, times[operations / 2] / 1000.0,
+        times[operations - 1] / 1000.0, failures);
+    success = success && failures == 0;
+  }
+
+  g_free(times);
+
+  return success;
+}
+
+static bool
+benchmark_render_cache(zathura_plugin_functions_t* functions, const char* path)
+{
+  zathura_document_t* document = document_open(functions, path);
+  if (document == NULL) {
+    return false;
+  }
+
+  unsigned int failures  = 0;
+  gint64 render_time     = 0;
+  gint64 compress_time   = 0;
+  gint64 decompress_time = 0;
+  size_t image_size      = 0;
+  size_t compressed_size = 0;
+
+  for (unsigned int i = 0; i < (unsigned int) operations; i++) {
+    zathura_page_t* page = document->pages[i % document->number_of_pages];
+    pdf_page_t* pdf_page = page->data;
+    const unsigned int round = i / document->number_of_pages;
+    cairo_t* cairo = create_target(page, scales[round % G_N_ELEMENTS(scales)]);
+
+    gint64 start = g_get_monotonic_time();
+    const zathura_error_t error = functions->page_render_cairo(page, pdf_page,
+        cairo, false);
+    render_time += g_get_monotonic_time() - start;
+
+    /* the image the page cache keeps is what ends up in the render cache */
+    g_mutex_lock(&pdf_page->lock);
+    cairo_surface_t* surface = pdf_page->cache.surface != NULL ?
+      cairo_surface_reference(pdf_page->cache.surface) : NULL;
+    pdf_surface_encoding_t encoding = pdf_page->cache.surface_encoding;
+    g_mutex_unlock(&pdf_page->lock);
+    cairo_destroy(cairo);
+
+    if (error != ZATHURA_ERROR_OK || surface == NULL) {
+      cairo_surface_destroy(surface);
+      failures++;
+      continue;
+    }
+
+    start = g_get_monotonic_time();
+    GBytes* data = pdf_render_cache_compress(surface, encoding);
+    compress_time += g_get_monotonic_time() - start;
+
+    cairo_surface_t* decompressed = NULL;
+    if (data != NULL) {
+      start = g_get_monotonic_time();
+      decompressed = pdf_render_cache_decompress(data, &encoding);
+      decompress_time += g_get_monotonic_time() - start;
+
+      image_size      += (size_t) cairo_image_surface_get_stride(surface) *
+        cairo_image_surface_get_height(surface);
+      compressed_size += g_bytes_get_size(data);
+      g_bytes_unref(data);
+    }
+
+    if (decompressed == NULL) {
+      failures++;
+    } else {
+      cairo_surface_destroy(decompressed);
+    }
+    cairo_surface_destroy(surface);
+  }
+
+  document_close(functions, document);
+
+  const unsigned int succeeded = MAX((unsigned int) operations - failures, 1);
+  printf("%10s %12s %14s %10s %9s\n", "render ms", "compress ms",
+      "decompress ms", "size", "failures");
+  printf("%10.2f %12.2f %14.2f %9.1f%% %9u\n",
+      render_time / 1000.0 / operations, compress_time / 1000.0 / succeeded,
+      decompress_time / 1000.0 / succeeded,
+      100.0 * compressed_size / MAX(image_size, 1), failures);
+
+  return failures == 0;
+}
+
+static bool
+perform(run_t* run, unsigned int operation)
+{
+  zathura_plugin_functions_t* functions = run->functions;
+  zathura_document_t* document          = run->document;
+
+  zathura_page_t* page = document->pages[operation % document->number_of_pages];
+  const unsigned int round = operation / document->number_of_pages;
+  const unsigned int kind  = run->render_only == true ? 0 :
+    (operation + round) % OPERATION_CYCLE;
+
+  /* pages without matches, links or text are not an error */
+  zathura_error_t error = ZATHURA_ERROR_OK;
+  if (kind == OPERATION_SEARCH) {
+    girara_list_t* results = functions->page_search_text(page, page->data,
+        run->search_term, &error);
+    if (results != NULL) {
+      girara_list_free(results);
+    }
+  } else if (kind == OPERATION_LINKS) {
+    girara_list_t* links = functions->page_links_get(page, page->data, &error);
+    if (links != NULL) {
+      girara_list_free(links);
+    }
+  } else if (kind == OPERATION_TEXT) {
+    const zathura_rectangle_t rectangle = { 0, 0, page->width, page->height };
+    g_free(functions->page_get_text(page, page->data, rectangle, &error));
+  } else {
+    return render(functions, page, scales[round % G_N_ELEMENTS(scales)]);
+  }
+
+  return true;
+}
+
+static gpointer
+worker(gpointer data)
+{
+  run_t* run = data;
+
+  while (true) {
+    const unsigned int operation = g_atomic_int_add(&run->next, 1);
+    if (operation >= run->operations) {
+      break;
+    }
+
+    if (perform(run, operation) == false) {
+      g_atomic_int_inc(&run->failures);
+    }
+  }
+
+  return NULL;
+}
+
+static double
+run_threads(zathura_plugin_functions_t* functions, const char* path, unsigned
+    int threads, unsigned int* failures)
+{
+  run_t run = {
+    .functions   = functions,
+    .document    = document_open(functions, path),
+    .operations  = operations,
+    .render_only = render_only == TRUE,
+    .search_term = search_term
+  };
+
+  if (run.document == NULL) {
+    *failures = operations;
+    return 0;
+  }
+
+  GThread** workers  = g_malloc(sizeof(GThread*) * threads);
+  const gint64 start = g_get_monotonic_time();
+
+  for (unsigned int i = 0; i < threads; i++) {
+    workers[i] = g_thread_new("stress-worker", worker, &run);
+  }
+  for (unsigned int i = 0; i < threads; i++) {
+    g_thread_join(workers[i]);
+  }
+
+  const gint64 duration = g_get_monotonic_time() - start;
+
+  g_free(workers);
+  document_close(functions, run.document);
+
+  *failures = g_atomic_int_get(&run.failures);
+
+  return run.operations * (double) G_USEC_PER_SEC / MAX(duration, 1);
+}
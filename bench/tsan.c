@@ -0,0 +1,191 @@
+/* See LICENSE file for license and copyright information */
+
+#define _XOPEN_SOURCE 700
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "tsan.h"
+
+/* one lock for all one-time initializations, held while the value is
+ * initialized */
+static pthread_mutex_t once_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_mutex_t* mutex_get(gpointer* location, int type);
+static void mutex_free(gpointer* location);
+static pthread_cond_t* cond_get(gpointer* location);
+
+void
+bench_mutex_init(GMutex* mutex)
+{
+  mutex->p = NULL;
+}
+
+void
+bench_mutex_clear(GMutex* mutex)
+{
+  mutex_free(&mutex->p);
+}
+
+void
+bench_mutex_lock(GMutex* mutex)
+{
+  pthread_mutex_lock(mutex_get(&mutex->p, PTHREAD_MUTEX_NORMAL));
+}
+
+gboolean
+bench_mutex_trylock(GMutex* mutex)
+{
+  return pthread_mutex_trylock(mutex_get(&mutex->p, PTHREAD_MUTEX_NORMAL)) == 0;
+}
+
+void
+bench_mutex_unlock(GMutex* mutex)
+{
+  pthread_mutex_unlock(mutex_get(&mutex->p, PTHREAD_MUTEX_NORMAL));
+}
+
+void
+bench_rec_mutex_init(GRecMutex* mutex)
+{
+  mutex->p = NULL;
+}
+
+void
+bench_rec_mutex_clear(GRecMutex* mutex)
+{
+  mutex_free(&mutex->p);
+}
+
+void
+bench_rec_mutex_lock(GRecMutex* mutex)
+{
+  pthread_mutex_lock(mutex_get(&mutex->p, PTHREAD_MUTEX_RECURSIVE));
+}
+
+gboolean
+bench_rec_mutex_trylock(GRecMutex* mutex)
+{
+  return pthread_mutex_trylock(mutex_get(&mutex->p, PTHREAD_MUTEX_RECURSIVE)) == 0;
+}
+
+void
+bench_rec_mutex_unlock(GRecMutex* mutex)
+{
+  pthread_mutex_unlock(mutex_get(&mutex->p, PTHREAD_MUTEX_RECURSIVE));
+}
+
+void
+bench_cond_init(GCond* cond)
+{
+  cond->p = NULL;
+}
+
+void
+bench_cond_clear(GCond* cond)
+{
+  pthread_cond_t* impl = cond->p;
+  if (impl != NULL) {
+    pthread_cond_destroy(impl);
+    free(impl);
+    cond->p = NULL;
+  }
+}
+
+void
+bench_cond_wait(GCond* cond, GMutex* mutex)
+{
+  pthread_cond_wait(cond_get(&cond->p), mutex_get(&mutex->p, PTHREAD_MUTEX_NORMAL));
+}
+
+void
+bench_cond_signal(GCond* cond)
+{
+  pthread_cond_signal(cond_get(&cond->p));
+}
+
+void
+bench_cond_broadcast(GCond* cond)
+{
+  pthread_cond_broadcast(cond_get(&cond->p));
+}
+
+gboolean
+bench_once_init_enter(void** location)
+{
+  pthread_mutex_lock(&once_lock);
+  if (*location != NULL) {
+    pthread_mutex_unlock(&once_lock);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+void
+bench_once_init_leave(void** location, void* result)
+{
+  *location = result;
+  pthread_mutex_unlock(&once_lock);
+}
+
+static pthread_mutex_t*
+mutex_get(gpointer* location, int type)
+{
+  /* statically allocated locks are only zeroed, so they are created on first
+   * use */
+  pthread_mutex_t* mutex = __atomic_load_n(location, __ATOMIC_ACQUIRE);
+  if (mutex != NULL) {
+    return mutex;
+  }
+
+  pthread_mutexattr_t attributes;
+  pthread_mutexattr_init(&attributes);
+  pthread_mutexattr_settype(&attributes, type);
+  mutex = malloc(sizeof(pthread_mutex_t));
+  pthread_mutex_init(mutex, &attributes);
+  pthread_mutexattr_destroy(&attributes);
+
+  gpointer expected = NULL;
+  if (__atomic_compare_exchange_n(location, &expected, mutex, FALSE,
+        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) == FALSE) {
+    pthread_mutex_destroy(mutex);
+    free(mutex);
+    mutex = expected;
+  }
+
+  return mutex;
+}
+
+static void
+mutex_free(gpointer* location)
+{
+  pthread_mutex_t* mutex = *location;
+  if (mutex != NULL) {
+    pthread_mutex_destroy(mutex);
+    free(mutex);
+    *location = NULL;
+  }
+}
+
+static pthread_cond_t*
+cond_get(gpointer* location)
+{
+  pthread_cond_t* cond = __atomic_load_n(location, __ATOMIC_ACQUIRE);
+  if (cond != NULL) {
+    return cond;
+  }
+
+  cond = malloc(sizeof(pthread_cond_t));
+  pthread_cond_init(cond, NULL);
+
+  gpointer expected = NULL;
+  if (__atomic_compare_exchange_n(location, &expected, cond, FALSE,
+        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) == FALSE) {
+    pthread_cond_destroy(cond);
+    free(cond);
+    cond = expected;
+  }
+
+  return cond;
+}
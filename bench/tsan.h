@@ -0,0 +1,58 @@
+/* See LICENSE file for license and copyright information */
+
+#ifndef BENCH_TSAN_H
+#define BENCH_TSAN_H
+
+/* GLib implements its locks with futexes, which ThreadSanitizer does not know
+ * about, so every lock would look like a data race. The stress build
+ * includes this header into every file to replace the locks of GLib with
+ * ones built on pthreads. */
+
+#include <glib.h>
+
+void bench_mutex_init(GMutex* mutex);
+void bench_mutex_clear(GMutex* mutex);
+void bench_mutex_lock(GMutex* mutex);
+gboolean bench_mutex_trylock(GMutex* mutex);
+void bench_mutex_unlock(GMutex* mutex);
+
+void bench_rec_mutex_init(GRecMutex* mutex);
+void bench_rec_mutex_clear(GRecMutex* mutex);
+void bench_rec_mutex_lock(GRecMutex* mutex);
+gboolean bench_rec_mutex_trylock(GRecMutex* mutex);
+void bench_rec_mutex_unlock(GRecMutex* mutex);
+
+void bench_cond_init(GCond* cond);
+void bench_cond_clear(GCond* cond);
+void bench_cond_wait(GCond* cond, GMutex* mutex);
+void bench_cond_signal(GCond* cond);
+void bench_cond_broadcast(GCond* cond);
+
+gboolean bench_once_init_enter(void** location);
+void bench_once_init_leave(void** location, void* result);
+
+#define g_mutex_init bench_mutex_init
+#define g_mutex_clear bench_mutex_clear
+#define g_mutex_lock bench_mutex_lock
+#define g_mutex_trylock bench_mutex_trylock
+#define g_mutex_unlock bench_mutex_unlock
+
+#define g_rec_mutex_init bench_rec_mutex_init
+#define g_rec_mutex_clear bench_rec_mutex_clear
+#define g_rec_mutex_lock bench_rec_mutex_lock
+#define g_rec_mutex_trylock bench_rec_mutex_trylock
+#define g_rec_mutex_unlock bench_rec_mutex_unlock
+
+#define g_cond_init bench_cond_init
+#define g_cond_clear bench_cond_clear
+#define g_cond_wait bench_cond_wait
+#define g_cond_signal bench_cond_signal
+#define g_cond_broadcast bench_cond_broadcast
+
+#undef g_once_init_enter
+#undef g_once_init_leave
+#define g_once_init_enter(location) bench_once_init_enter((void**) (location))
+#define g_once_init_leave(location, result) \
+  bench_once_init_leave((void**) (location), (void*) (result))
+
+#endif // BENCH_TSAN_H
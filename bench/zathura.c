@@ -0,0 +1,275 @@
+/* See LICENSE file for license and copyright information */
+
+/* The parts of the zathura API the plugin uses, so that it can be driven
+ * without zathura. Only what the plugin needs is implemented. */
+
+#include "zathura.h"
+
+struct zathura_link_s {
+  zathura_link_type_t type;
+  zathura_rectangle_t position;
+  zathura_link_target_t target;
+};
+
+struct zathura_document_information_entry_s {
+  zathura_document_information_type_t type;
+  char* value;
+};
+
+static void information_entry_free(void* data);
+
+zathura_document_t*
+bench_document_new(const char* path, const char* password)
+{
+  zathura_document_t* document = g_malloc0(sizeof(zathura_document_t));
+  document->path     = g_strdup(path);
+  document->password = g_strdup(password);
+
+  return document;
+}
+
+void
+bench_document_free(zathura_document_t* document)
+{
+  if (document == NULL) {
+    return;
+  }
+
+  for (unsigned int i = 0; i < document->number_of_pages; i++) {
+    g_free(document->pages[i]);
+  }
+  g_free(document->pages);
+  g_free(document->path);
+  g_free(document->password);
+  g_free(document);
+}
+
+const char*
+zathura_document_get_path(zathura_document_t* document)
+{
+  return document->path;
+}
+
+const char*
+zathura_document_get_password(zathura_document_t* document)
+{
+  return document->password;
+}
+
+void*
+zathura_document_get_data(zathura_document_t* document)
+{
+  return document->data;
+}
+
+void
+zathura_document_set_data(zathura_document_t* document, void* data)
+{
+  document->data = data;
+}
+
+unsigned int
+zathura_document_get_number_of_pages(zathura_document_t* document)
+{
+  return document->number_of_pages;
+}
+
+void
+zathura_document_set_number_of_pages(zathura_document_t* document, unsigned
+    int number_of_pages)
+{
+  for (unsigned int i = 0; i < document->number_of_pages; i++) {
+    g_free(document->pages[i]);
+  }
+  g_free(document->pages);
+
+  document->number_of_pages = number_of_pages;
+  document->pages           = g_malloc0(sizeof(zathura_page_t*) * MAX(number_of_pages, 1));
+  for (unsigned int i = 0; i < number_of_pages; i++) {
+    document->pages[i] = g_malloc0(sizeof(zathura_page_t));
+    document->pages[i]->document = document;
+    document->pages[i]->index    = i;
+  }
+}
+
+zathura_page_t*
+zathura_document_get_page(zathura_document_t* document, unsigned int index)
+{
+  return index < document->number_of_pages ? document->pages[index] : NULL;
+}
+
+void
+zathura_document_set_page_layout(zathura_document_t* document, unsigned int
+    page_padding, unsigned int pages_per_row, unsigned int first_page_column)
+{
+}
+
+unsigned int
+zathura_document_get_page_padding(zathura_document_t* document)
+{
+  return 0;
+}
+
+unsigned int
+zathura_document_get_pages_per_row(zathura_document_t* document)
+{
+  return 1;
+}
+
+unsigned int
+zathura_document_get_first_page_column(zathura_document_t* document)
+{
+  return 1;
+}
+
+zathura_document_t*
+zathura_page_get_document(zathura_page_t* page)
+{
+  return page->document;
+}
+
+unsigned int
+zathura_page_get_index(zathura_page_t* page)
+{
+  return page->index;
+}
+
+double
+zathura_page_get_width(zathura_page_t* page)
+{
+  return page->width;
+}
+
+double
+zathura_page_get_height(zathura_page_t* page)
+{
+  return page->height;
+}
+
+void
+zathura_page_set_width(zathura_page_t* page, double width)
+{
+  page->width = width;
+}
+
+void
+zathura_page_set_height(zathura_page_t* page, double height)
+{
+  page->height = height;
+}
+
+void*
+zathura_page_get_data(zathura_page_t* page)
+{
+  return page->data;
+}
+
+void
+zathura_page_set_data(zathura_page_t* page, void* data)
+{
+  page->data = data;
+}
+
+zathura_link_t*
+zathura_link_new(zathura_link_type_t type, zathura_rectangle_t position,
+    zathura_link_target_t target)
+{
+  zathura_link_t* link = g_malloc0(sizeof(zathura_link_t));
+  link->type         = type;
+  link->position     = position;
+  link->target       = target;
+  link->target.value = g_strdup(target.value);
+
+  return link;
+}
+
+void
+zathura_link_free(zathura_link_t* link)
+{
+  if (link == NULL) {
+    return;
+  }
+
+  g_free(link->target.value);
+  g_free(link);
+}
+
+zathura_link_type_t
+zathura_link_get_type(zathura_link_t* link)
+{
+  return link != NULL ? link->type : ZATHURA_LINK_INVALID;
+}
+
+zathura_link_target_t
+zathura_link_get_target(zathura_link_t* link)
+{
+  return link->target;
+}
+
+zathura_index_element_t*
+zathura_index_element_new(const char* title)
+{
+  zathura_index_element_t* element = g_malloc0(sizeof(zathura_index_element_t));
+  element->title = g_strdup(title);
+
+  return element;
+}
+
+void
+zathura_index_element_free(zathura_index_element_t* element)
+{
+  if (element == NULL) {
+    return;
+  }
+
+  g_free(element->title);
+  zathura_link_free(element->link);
+  g_free(element);
+}
+
+girara_list_t*
+zathura_document_information_entry_list_new(void)
+{
+  return girara_list_new2(information_entry_free);
+}
+
+zathura_document_information_entry_t*
+zathura_document_information_entry_new(zathura_document_information_type_t
+    type, const char* value)
+{
+  zathura_document_information_entry_t* entry =
+    g_malloc0(sizeof(zathura_document_information_entry_t));
+  entry->type  = type;
+  entry->value = g_strdup(value);
+
+  return entry;
+}
+
+#ifndef ZATHURA_PLUGIN_REGISTER_WITH_FUNCTIONS
+/* the plugin registers itself through these, the driver calls
+ * register_functions directly */
+void
+zathura_plugin_set_register_functions_function(zathura_plugin_t* plugin,
+    zathura_plugin_register_function_t register_function)
+{
+}
+
+void
+zathura_plugin_set_name(zathura_plugin_t* plugin, const char* name)
+{
+}
+
+void
+zathura_plugin_add_mimetype(zathura_plugin_t* plugin, const char* mime_type)
+{
+}
+#endif
+
+static void
+information_entry_free(void* data)
+{
+  zathura_document_information_entry_t* entry = data;
+
+  g_free(entry->value);
+  g_free(entry);
+}
@@ -0,0 +1,47 @@
+/* See LICENSE file for license and copyright information */
+
+#ifndef BENCH_ZATHURA_H
+#define BENCH_ZATHURA_H
+
+#include "../plugin.h"
+
+/**
+ * Minimal document of the host, just enough for the plugin
+ */
+struct zathura_document_s {
+  char* path; /**< Path of the file */
+  char* password; /**< Password or NULL */
+  void* data; /**< Data of the plugin */
+  unsigned int number_of_pages; /**< Number of pages */
+  zathura_page_t** pages; /**< Pages */
+};
+
+/**
+ * Minimal page of the host, just enough for the plugin
+ */
+struct zathura_page_s {
+  zathura_document_t* document; /**< Document the page belongs to */
+  unsigned int index; /**< Page index */
+  double width; /**< Width of the page */
+  double height; /**< Height of the page */
+  void* data; /**< Data of the plugin */
+};
+
+/**
+ * Creates a document for the given file. The plugin fills it when the
+ * document is opened.
+ *
+ * @param path Path of the file
+ * @param password Password or NULL
+ * @return The document
+ */
+zathura_document_t* bench_document_new(const char* path, const char* password);
+
+/**
+ * Frees a document and its pages. The plugin data has to be freed before.
+ *
+ * @param document The document
+ */
+void bench_document_free(zathura_document_t* document);
+
+#endif // BENCH_ZATHURA_H
@@ -0,0 +1,253 @@
+/* See LICENSE file for license and copyright information */
+
+#include <string.h>
+#include <time.h>
+
+#include <glib/gstdio.h>
+#include <girara/utils.h>
+
+#include "cachefile.h"
+
+#define CACHE_FILE_MAGIC "ZPPC"
+#define CACHE_FILE_VERSION 1
+#define CACHE_FILE_SAMPLE_SIZE (64 * 1024)
+/* Number of cached documents. Every change to a document results in a new
+ * key, so the least recently used files are pruned beyond this. */
+#define CACHE_FILE_MAX_FILES 256
+/* Files are only marked as used again after this many seconds */
+#define CACHE_FILE_TOUCH_INTERVAL (60 * 60)
+
+/**
+ * Header of a cache file. It is followed by a width and height pair for
+ * every page. The files are meant to be shared between instances on the same
+ * machine, so everything is stored in native byte order.
+ */
+typedef struct cache_file_header_s {
+  char magic[4]; /**< CACHE_FILE_MAGIC */
+  guint32 version; /**< CACHE_FILE_VERSION */
+  guint32 number_of_pages; /**< Number of pages */
+  guint32 reserved; /**< Padding */
+} cache_file_header_t;
+
+/**
+ * A file found while pruning the cache
+ */
+typedef struct cache_file_s {
+  char* path; /**< Path of the file */
+  time_t time; /**< Time the file was last used */
+} cache_file_t;
+
+static char* get_cache_file_path(const char* key);
+static void prune_files(const char* directory);
+static gint compare_files(gconstpointer a, gconstpointer b);
+static void file_free(gpointer data);
+
+char*
+pdf_cache_file_get_key(const char* path)
+{
+  if (path == NULL) {
+    return NULL;
+  }
+
+  GMappedFile* file = g_mapped_file_new(path, FALSE, NULL);
+  if (file == NULL) {
+    return NULL;
+  }
+
+  const guchar* contents = (const guchar*) g_mapped_file_get_contents(file);
+  const gsize length     = g_mapped_file_get_length(file);
+  const gsize sample     = MIN(length, CACHE_FILE_SAMPLE_SIZE);
+
+  GChecksum* checksum = g_checksum_new(G_CHECKSUM_SHA256);
+  const guint64 size = length;
+  g_checksum_update(checksum, (const guchar*) &size, sizeof(size));
+
+  /* the sampled regions miss edits in the middle of the file that keep its
+   * size, but those change the modification time */
+  GFile* gfile    = g_file_new_for_path(path);
+  GFileInfo* info = g_file_query_info(gfile, G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+      G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC "," G_FILE_ATTRIBUTE_UNIX_INODE ","
+      G_FILE_ATTRIBUTE_UNIX_DEVICE, G_FILE_QUERY_INFO_NONE, NULL, NULL);
+  g_object_unref(gfile);
+  if (info == NULL) {
+    g_checksum_free(checksum);
+    g_mapped_file_unref(file);
+    return NULL;
+  }
+
+  const guint64 identity[4] = {
+    g_file_info_get_attribute_uint64(info, G_FILE_ATTRIBUTE_TIME_MODIFIED),
+    g_file_info_get_attribute_uint32(info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC),
+    g_file_info_get_attribute_uint64(info, G_FILE_ATTRIBUTE_UNIX_INODE),
+    g_file_info_get_attribute_uint32(info, G_FILE_ATTRIBUTE_UNIX_DEVICE)
+  };
+  g_object_unref(info);
+  g_checksum_update(checksum, (const guchar*) identity, sizeof(identity));
+  if (contents != NULL) {
+    g_checksum_update(checksum, contents, sample);
+    g_checksum_update(checksum, contents + length - sample, sample);
+  }
+
+  char* key = g_strdup(g_checksum_get_string(checksum));
+
+  g_checksum_free(checksum);
+  g_mapped_file_unref(file);
+
+  return key;
+}
+
+double*
+pdf_cache_file_load(const char* key, unsigned int number_of_pages)
+{
+  if (key == NULL || number_of_pages == 0) {
+    return NULL;
+  }
+
+  char* path     = get_cache_file_path(key);
+  char* contents = NULL;
+  gsize length   = 0;
+
+  if (g_file_get_contents(path, &contents, &length, NULL) == FALSE) {
+    g_free(path);
+    return NULL;
+  }
+
+  /* files are pruned by the time they were last used */
+  GStatBuf buffer;
+  if (g_stat(path, &buffer) == 0 &&
+      time(NULL) - buffer.st_mtime > CACHE_FILE_TOUCH_INTERVAL) {
+    g_utime(path, NULL);
+  }
+  g_free(path);
+
+  const gsize sizes_length = 2 * sizeof(double) * number_of_pages;
+  if (length != sizeof(cache_file_header_t) + sizes_length) {
+    g_free(contents);
+    return NULL;
+  }
+
+  cache_file_header_t header;
+  memcpy(&header, contents, sizeof(header));
+  if (memcmp(header.magic, CACHE_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != CACHE_FILE_VERSION ||
+      header.number_of_pages != number_of_pages) {
+    g_free(contents);
+    return NULL;
+  }
+
+  double* page_sizes = g_malloc(sizes_length);
+  memcpy(page_sizes, contents + sizeof(header), sizes_length);
+  g_free(contents);
+
+  return page_sizes;
+}
+
+bool
+pdf_cache_file_save(const char* key, unsigned int number_of_pages, const
+    double* page_sizes)
+{
+  if (key == NULL || number_of_pages == 0 || page_sizes == NULL) {
+    return false;
+  }
+
+  char* path      = get_cache_file_path(key);
+  char* directory = g_path_get_dirname(path);
+  if (g_mkdir_with_parents(directory, 0700) != 0) {
+    girara_warning("Failed to create cache directory %s", directory);
+    g_free(directory);
+    g_free(path);
+    return false;
+  }
+
+  prune_files(directory);
+  g_free(directory);
+
+  cache_file_header_t header = {
+    .magic           = CACHE_FILE_MAGIC,
+    .version         = CACHE_FILE_VERSION,
+    .number_of_pages = number_of_pages,
+    .reserved        = 0
+  };
+
+  const gsize sizes_length = 2 * sizeof(double) * number_of_pages;
+  GString* contents = g_string_sized_new(sizeof(header) + sizes_length);
+  g_string_append_len(contents, (const char*) &header, sizeof(header));
+  g_string_append_len(contents, (const char*) page_sizes, sizes_length);
+
+  /* the file is replaced atomically, so concurrent instances never read a
+   * partially written file */
+  const bool ret = g_file_set_contents(path, contents->str, contents->len, NULL) == TRUE;
+
+  g_string_free(contents, TRUE);
+  g_free(path);
+
+  return ret;
+}
+
+static char*
+get_cache_file_path(const char* key)
+{
+  return g_build_filename(g_get_user_cache_dir(), "zathura-pdf-poppler", key, NULL);
+}
+
+static void
+prune_files(const char* directory)
+{
+  GDir* dir = g_dir_open(directory, 0, NULL);
+  if (dir == NULL) {
+    return;
+  }
+
+  GPtrArray* files = g_ptr_array_new_with_free_func(file_free);
+
+  /* other entries, like the directory of the render cache, are left alone */
+  const char* name = NULL;
+  while ((name = g_dir_read_name(dir)) != NULL) {
+    char* path = g_build_filename(directory, name, NULL);
+
+    GStatBuf buffer;
+    if (g_stat(path, &buffer) != 0 || S_ISREG(buffer.st_mode) == 0) {
+      g_free(path);
+      continue;
+    }
+
+    cache_file_t* file = g_malloc(sizeof(cache_file_t));
+    file->path = path;
+    file->time = buffer.st_mtime;
+    g_ptr_array_add(files, file);
+  }
+  g_dir_close(dir);
+
+  /* least recently used files go first, down to three quarters of the limit
+   * so that not every write prunes again. The file about to be written is
+   * not counted yet. */
+  if (files->len >= CACHE_FILE_MAX_FILES) {
+    const guint remove = files->len - (CACHE_FILE_MAX_FILES - CACHE_FILE_MAX_FILES / 4);
+
+    g_ptr_array_sort(files, compare_files);
+    for (guint i = 0; i < remove; i++) {
+      cache_file_t* file = g_ptr_array_index(files, i);
+      g_remove(file->path);
+    }
+  }
+
+  g_ptr_array_unref(files);
+}
+
+static gint
+compare_files(gconstpointer a, gconstpointer b)
+{
+  const cache_file_t* file_a = *(cache_file_t* const*) a;
+  const cache_file_t* file_b = *(cache_file_t* const*) b;
+
+  return (file_a->time > file_b->time) - (file_a->time < file_b->time);
+}
+
+static void
+file_free(gpointer data)
+{
+  cache_file_t* file = data;
+
+  g_free(file->path);
+  g_free(file);
+}
@@ -0,0 +1,48 @@
+/* See LICENSE file for license and copyright information */
+
+#ifndef CACHEFILE_H
+#define CACHEFILE_H
+
+#include "plugin.h"
+
+/**
+ * Name of the environment variable that enables the document cache
+ */
+#define PDF_CACHE_FILE_OPTION "ZATHURA_PDF_POPPLER_CACHE"
+
+/**
+ * Computes the key of a document in the cache. The key is a hash over the
+ * identity of the file (device, inode and modification time), its size and
+ * its beginning and end. Writing to the file changes its modification time,
+ * so edits that keep the size and leave the sampled regions alone still
+ * result in a new key. Only a file that is rewritten with its old
+ * modification time restored can keep its key.
+ *
+ * @param path Path to the document
+ * @return The key (needs to be deallocated with g_free) or NULL if an error
+ *   occurred
+ */
+char* pdf_cache_file_get_key(const char* path);
+
+/**
+ * Loads the page sizes of a document from the cache
+ *
+ * @param key Key of the document
+ * @param number_of_pages Number of pages of the document
+ * @return Array of width and height pairs (needs to be deallocated with
+ *   g_free) or NULL if the document is not cached
+ */
+double* pdf_cache_file_load(const char* key, unsigned int number_of_pages);
+
+/**
+ * Stores the page sizes of a document in the cache
+ *
+ * @param key Key of the document
+ * @param number_of_pages Number of pages of the document
+ * @param page_sizes Array of width and height pairs
+ * @return true if the cache file has been written
+ */
+bool pdf_cache_file_save(const char* key, unsigned int number_of_pages,
+    const double* page_sizes);
+
+#endif // CACHEFILE_H
@@ -33,6 +33,9 @@ CAIRO_LIB ?= $(shell $(PKG_CONFIG) --libs cairo)
 PDF_INC ?= $(shell $(PKG_CONFIG) --cflags poppler-glib)
 PDF_LIB ?= $(shell $(PKG_CONFIG) --libs poppler-glib)
 
+LZ4_INC ?= $(shell $(PKG_CONFIG) --cflags liblz4)
+LZ4_LIB ?= $(shell $(PKG_CONFIG) --libs liblz4)
+
 GIRARA_INC ?= $(shell $(PKG_CONFIG) --cflags girara-gtk3)
 GIRARA_LIB ?= $(shell $(PKG_CONFIG) --libs girara-gtk3)
 
@@ -42,8 +45,8 @@ ifeq (,${PLUGINDIR})
 PLUGINDIR = ${LIBDIR}/zathura
 endif
 
-INCS = ${CAIRO_INC} ${PDF_INC} ${ZATHURA_INC} ${GIRARA_INC}
-LIBS = ${GIRARA_LIB} ${CAIRO_LIB} ${PDF_LIB}
+INCS = ${CAIRO_INC} ${PDF_INC} ${LZ4_INC} ${ZATHURA_INC} ${GIRARA_INC}
+LIBS = ${GIRARA_LIB} ${CAIRO_LIB} ${PDF_LIB} ${LZ4_LIB}
 
 # uname
 UNAME := $(shell uname -s)
@@ -60,6 +63,10 @@ endif
 # debug
 DFLAGS ?= -g
 
+# stress test and benchmark (see bench/stress.c)
+STRESSFLAGS ?= -g -O1 -fsanitize=thread
+BENCHMARKFLAGS ?= -O2
+
 # compiler
 CC ?= gcc
 LD ?= ld
@@ -2,6 +2,38 @@
 
 #include "plugin.h"
 #include "utils.h"
+#include "cachefile.h"
+#include "rendercache.h"
+#include "profiler.h"
+#include "outline.h"
+#include "task.h"
+
+#define PAGE_SIZE_UPDATE_INTERVAL 100
+
+/**
+ * File to open asynchronously
+ */
+typedef struct open_request_s {
+  char* path; /**< Path of the file */
+  char* password; /**< Password or NULL */
+} open_request_t;
+
+static PopplerDocument* open_poppler_document(const char* path, const char*
+    password, GCancellable* cancellable, zathura_error_t* error);
+static pdf_document_t* document_new(const char* path, PopplerDocument*
+    poppler_document, GTask* task);
+static void document_attach(zathura_document_t* document, pdf_document_t*
+    pdf_document);
+static void document_free(pdf_document_t* pdf_document);
+static void open_thread(GTask* task, gpointer source, gpointer task_data,
+    GCancellable* cancellable);
+static void open_request_free(gpointer data);
+static double* load_page_sizes(PopplerDocument* poppler_document, unsigned
+    int number_of_pages, GTask* task);
+static void page_size_loader_start(pdf_document_t* pdf_document);
+static void page_size_loader_stop(pdf_document_t* pdf_document);
+static gpointer page_size_loader(gpointer data);
+static gboolean apply_page_sizes(gpointer data);
 
 zathura_error_t
 pdf_document_open(zathura_document_t* document)
@@ -11,69 +43,170 @@ pdf_document_open(zathura_document_t* document)
   }
 
   zathura_error_t error = ZATHURA_ERROR_OK;
+  const char* path      = zathura_document_get_path(document);
 
-  /* format path */
-  GError* gerror  = NULL;
-  char* file_uri = g_filename_to_uri(zathura_document_get_path(document), NULL, NULL);
-
-  if (file_uri == NULL) {
-    error = ZATHURA_ERROR_UNKNOWN;
-    goto error_free;
-  }
-
-  PopplerDocument* poppler_document = poppler_document_new_from_file(file_uri,
-      zathura_document_get_password(document), &gerror);
-
+  PopplerDocument* poppler_document = open_poppler_document(path,
+      zathura_document_get_password(document), NULL, &error);
   if (poppler_document == NULL) {
-    if (gerror != NULL && gerror->code == POPPLER_ERROR_ENCRYPTED) {
-      error = ZATHURA_ERROR_INVALID_PASSWORD;
-    } else {
-      error = ZATHURA_ERROR_UNKNOWN;
-    }
-    goto error_free;
+    return error;
   }
 
-  zathura_document_set_data(document, poppler_document);
+  document_attach(document, document_new(path, poppler_document, NULL));
 
-  zathura_document_set_number_of_pages(document,
-      poppler_document_get_n_pages(poppler_document));
+  return ZATHURA_ERROR_OK;
+}
 
-  g_free(file_uri);
+void
+pdf_document_open_async(zathura_document_t* document, GCancellable*
+    cancellable, pdf_progress_t progress, void* progress_data,
+    GAsyncReadyCallback callback, void* data)
+{
+  open_request_t* request = NULL;
+  if (document != NULL) {
+    request           = g_malloc0(sizeof(open_request_t));
+    request->path     = g_strdup(zathura_document_get_path(document));
+    request->password = g_strdup(zathura_document_get_password(document));
+  }
 
-  return ZATHURA_ERROR_OK;
+  /* a cancelled open returns right away, the worker drops the document once
+   * poppler is done with the file */
+  GTask* task = pdf_task_new(request, open_request_free, true, cancellable,
+      progress, progress_data, callback, data);
 
-error_free:
+  if (request == NULL) {
+    pdf_task_return_error(task, ZATHURA_ERROR_INVALID_ARGUMENTS);
+  } else {
+    g_task_run_in_thread(task, open_thread);
+  }
 
-  if (gerror != NULL) {
-    g_error_free(gerror);
+  g_object_unref(task);
+}
+
+zathura_error_t
+pdf_document_open_finish(zathura_document_t* document, GAsyncResult* result)
+{
+  if (document == NULL || result == NULL) {
+    return ZATHURA_ERROR_INVALID_ARGUMENTS;
   }
 
-  if (file_uri != NULL) {
-    g_free(file_uri);
+  zathura_error_t error        = ZATHURA_ERROR_OK;
+  pdf_document_t* pdf_document = pdf_task_finish(result, &error);
+  if (pdf_document == NULL) {
+    return error;
   }
 
-  return error;
+  document_attach(document, pdf_document);
+
+  return ZATHURA_ERROR_OK;
 }
 
 zathura_error_t
-pdf_document_free(zathura_document_t* document, PopplerDocument* poppler_document)
+pdf_document_free(zathura_document_t* document, pdf_document_t* pdf_document)
 {
   if (document == NULL) {
     return ZATHURA_ERROR_INVALID_ARGUMENTS;
   }
 
-  if (poppler_document != NULL) {
-    g_object_unref(poppler_document);
+  if (pdf_document != NULL) {
+    document_free(pdf_document);
     zathura_document_set_data(document, NULL);
   }
 
   return ZATHURA_ERROR_OK;
 }
 
+void
+pdf_document_lock(pdf_document_t* pdf_document)
+{
+  if (pdf_document != NULL) {
+    g_rec_mutex_lock(&pdf_document->lock);
+  }
+}
+
+void
+pdf_document_unlock(pdf_document_t* pdf_document)
+{
+  if (pdf_document != NULL) {
+    g_rec_mutex_unlock(&pdf_document->lock);
+  }
+}
+
+PopplerDocument*
+pdf_document_acquire_render_document(pdf_document_t* pdf_document)
+{
+  if (g_rec_mutex_trylock(&pdf_document->lock) == TRUE) {
+    return pdf_document->poppler_document;
+  }
+
+  g_mutex_lock(&pdf_document->render_copies_lock);
+  PopplerDocument* poppler_document = g_queue_pop_head(&pdf_document->render_copies);
+  const bool open = poppler_document == NULL &&
+    pdf_document->render_copies_disabled == false &&
+    pdf_document->render_copies_open + 1 < g_get_num_processors();
+  if (open == true) {
+    pdf_document->render_copies_open++;
+  }
+  g_mutex_unlock(&pdf_document->render_copies_lock);
+
+  if (open == true) {
+    poppler_document = pdf_open_poppler_document_copy(pdf_document);
+    if (poppler_document == NULL) {
+      g_mutex_lock(&pdf_document->render_copies_lock);
+      pdf_document->render_copies_open--;
+      g_cond_broadcast(&pdf_document->render_copies_released);
+      g_mutex_unlock(&pdf_document->render_copies_lock);
+    }
+  }
+
+  if (poppler_document == NULL) {
+    g_rec_mutex_lock(&pdf_document->lock);
+    return pdf_document->poppler_document;
+  }
+
+  return poppler_document;
+}
+
+void
+pdf_document_release_render_document(pdf_document_t* pdf_document,
+    PopplerDocument* poppler_document)
+{
+  if (poppler_document == pdf_document->poppler_document) {
+    g_rec_mutex_unlock(&pdf_document->lock);
+    return;
+  }
+
+  g_mutex_lock(&pdf_document->render_copies_lock);
+  const bool keep = pdf_document->render_copies_disabled == false;
+  if (keep == true) {
+    g_queue_push_head(&pdf_document->render_copies, poppler_document);
+  } else {
+    pdf_document->render_copies_open--;
+    g_cond_broadcast(&pdf_document->render_copies_released);
+  }
+  g_mutex_unlock(&pdf_document->render_copies_lock);
+
+  if (keep == false) {
+    g_object_unref(poppler_document);
+  }
+}
+
+void
+pdf_document_disable_render_copies(pdf_document_t* pdf_document)
+{
+  g_mutex_lock(&pdf_document->render_copies_lock);
+  pdf_document->render_copies_disabled = true;
+  GList* render_copies = pdf_document->render_copies.head;
+  pdf_document->render_copies_open -= pdf_document->render_copies.length;
+  g_queue_init(&pdf_document->render_copies);
+  g_mutex_unlock(&pdf_document->render_copies_lock);
+
+  g_list_free_full(render_copies, g_object_unref);
+}
+
 zathura_error_t
-pdf_document_save_as(zathura_document_t* document, PopplerDocument* poppler_document, const char* path)
+pdf_document_save_as(zathura_document_t* document, pdf_document_t* pdf_document, const char* path)
 {
-  if (document == NULL || poppler_document == NULL || path == NULL) {
+  if (document == NULL || pdf_document == NULL || path == NULL) {
     return ZATHURA_ERROR_INVALID_ARGUMENTS;
   }
 
@@ -83,8 +216,349 @@ pdf_document_save_as(zathura_document_t* document, PopplerDocument* poppler_docu
     return ZATHURA_ERROR_UNKNOWN;
   }
 
-  gboolean ret = poppler_document_save(poppler_document, file_uri, NULL);
+  gboolean ret = poppler_document_save(pdf_document->poppler_document, file_uri, NULL);
   g_free(file_uri);
 
   return (ret == TRUE ? ZATHURA_ERROR_OK : ZATHURA_ERROR_UNKNOWN);
 }
+
+static PopplerDocument*
+open_poppler_document(const char* path, const char* password, GCancellable*
+    cancellable, zathura_error_t* error)
+{
+  GError* gerror                    = NULL;
+  PopplerDocument* poppler_document = NULL;
+
+  /* documents opened through a stream read from it for their whole life,
+   * which is slower than the mapped file poppler uses otherwise. So opening
+   * is only skipped if it has been cancelled before it started. */
+  if (g_cancellable_is_cancelled(cancellable) == FALSE) {
+    /* format path */
+    char* file_uri = g_filename_to_uri(path, NULL, NULL);
+    if (file_uri != NULL) {
+      poppler_document = poppler_document_new_from_file(file_uri, password, &gerror);
+      g_free(file_uri);
+    }
+  }
+
+  if (poppler_document == NULL) {
+    if (g_error_matches(gerror, POPPLER_ERROR, POPPLER_ERROR_ENCRYPTED) == TRUE) {
+      *error = ZATHURA_ERROR_INVALID_PASSWORD;
+    } else {
+      *error = ZATHURA_ERROR_UNKNOWN;
+    }
+  }
+
+  if (gerror != NULL) {
+    g_error_free(gerror);
+  }
+
+  return poppler_document;
+}
+
+static pdf_document_t*
+document_new(const char* path, PopplerDocument* poppler_document, GTask* task)
+{
+  pdf_document_t* pdf_document   = g_malloc0(sizeof(pdf_document_t));
+  pdf_document->poppler_document = poppler_document;
+  pdf_document->number_of_pages  = MAX(poppler_document_get_n_pages(poppler_document), 0);
+  pdf_document->id_known         = pdf_get_document_id(poppler_document, pdf_document->id);
+  pdf_document->file_known       = pdf_get_file_state(path, &pdf_document->file_mtime,
+      &pdf_document->file_size);
+  g_rec_mutex_init(&pdf_document->lock);
+  g_mutex_init(&pdf_document->render_copies_lock);
+  g_cond_init(&pdf_document->render_copies_released);
+  g_queue_init(&pdf_document->render_copies);
+  g_mutex_init(&pdf_document->page_sizes_lock);
+  g_mutex_init(&pdf_document->outline_lock);
+  g_mutex_init(&pdf_document->render_profile_lock);
+  pdf_document->display_list_enabled = pdf_option_enabled(PDF_DISPLAY_LIST_OPTION);
+  /* the render cache holds the images dropped from the page caches */
+  pdf_document->image_cache_enabled = pdf_option_enabled(PDF_IMAGE_CACHE_OPTION) == true ||
+    pdf_render_cache_enabled() == true;
+
+  if (pdf_option_enabled(PDF_CACHE_FILE_OPTION) == true) {
+    pdf_document->cache_key  = pdf_cache_file_get_key(path);
+    pdf_document->page_sizes = pdf_cache_file_load(pdf_document->cache_key,
+        pdf_document->number_of_pages);
+  }
+
+  /* an asynchronous open is already off the main thread, so it loads every
+   * page size there and reports progress per page. Otherwise linearized
+   * documents load their page sizes in the background once they are
+   * attached (see document_attach). */
+  if (pdf_document->page_sizes != NULL) {
+    pdf_document->page_sizes_loaded = pdf_document->number_of_pages;
+  } else if (task != NULL || (pdf_document->cache_key != NULL &&
+        (pdf_document->number_of_pages <= 1 ||
+         poppler_document_is_linearized(poppler_document) == FALSE))) {
+    pdf_document->page_sizes = load_page_sizes(poppler_document,
+        pdf_document->number_of_pages, task);
+    if (pdf_document->page_sizes != NULL) {
+      pdf_document->page_sizes_loaded = pdf_document->number_of_pages;
+      if (pdf_document->cache_key != NULL) {
+        pdf_cache_file_save(pdf_document->cache_key, pdf_document->number_of_pages,
+            pdf_document->page_sizes);
+      }
+    }
+  }
+
+  if (pdf_render_cache_enabled() == true) {
+    pdf_document->render_cache_key = pdf_document->cache_key != NULL ?
+      g_strdup(pdf_document->cache_key) : pdf_cache_file_get_key(path);
+  }
+
+  pdf_memory_ref();
+
+  pdf_document->profiler = pdf_profiler_new(pdf_document->number_of_pages);
+
+  return pdf_document;
+}
+
+static void
+document_attach(zathura_document_t* document, pdf_document_t* pdf_document)
+{
+  pdf_document->document = document;
+
+  if (pdf_document->page_sizes == NULL && pdf_document->number_of_pages > 1 &&
+      poppler_document_is_linearized(pdf_document->poppler_document) == TRUE) {
+    /* the number of pages and the first page are available from the
+     * linearization data, the rest of the page tree is loaded later */
+    page_size_loader_start(pdf_document);
+  }
+
+  zathura_document_set_data(document, pdf_document);
+
+  zathura_document_set_number_of_pages(document, pdf_document->number_of_pages);
+}
+
+static void
+document_free(pdf_document_t* pdf_document)
+{
+  page_size_loader_stop(pdf_document);
+
+  /* renders on copies of the document do not hold its lock, they are waited
+   * for until they returned their copy */
+  pdf_document_disable_render_copies(pdf_document);
+  g_mutex_lock(&pdf_document->render_copies_lock);
+  while (pdf_document->render_copies_open > 0) {
+    g_cond_wait(&pdf_document->render_copies_released,
+        &pdf_document->render_copies_lock);
+  }
+  g_mutex_unlock(&pdf_document->render_copies_lock);
+
+  /* every other function using the document holds the lock, so it is freed
+   * once they returned */
+  pdf_document_lock(pdf_document);
+  pdf_profiler_free(pdf_document->profiler);
+  g_object_unref(pdf_document->poppler_document);
+  pdf_document_unlock(pdf_document);
+  g_rec_mutex_clear(&pdf_document->lock);
+  g_mutex_clear(&pdf_document->render_copies_lock);
+  g_cond_clear(&pdf_document->render_copies_released);
+  g_mutex_clear(&pdf_document->render_profile_lock);
+  g_mutex_clear(&pdf_document->page_sizes_lock);
+  g_mutex_clear(&pdf_document->outline_lock);
+  pdf_outline_free(pdf_document->outline);
+  pdf_page_labels_free(pdf_document->page_labels, pdf_document->number_of_pages);
+  g_free(pdf_document->page_sizes);
+  g_free(pdf_document->cache_key);
+  g_free(pdf_document->render_cache_key);
+  g_free(pdf_document);
+  pdf_memory_unref();
+}
+
+static void
+open_thread(GTask* task, gpointer source, gpointer task_data, GCancellable*
+    cancellable)
+{
+  open_request_t* request = pdf_task_get_object(task);
+  zathura_error_t error   = ZATHURA_ERROR_OK;
+
+  PopplerDocument* poppler_document = open_poppler_document(request->path,
+      request->password, cancellable, &error);
+  if (poppler_document == NULL) {
+    pdf_task_return_error(task, error);
+    return;
+  }
+
+  pdf_document_t* pdf_document = document_new(request->path, poppler_document, task);
+  pdf_task_progress(task, pdf_document->number_of_pages, pdf_document->number_of_pages);
+  pdf_task_return(task, pdf_document, (GDestroyNotify) document_free);
+}
+
+static void
+open_request_free(gpointer data)
+{
+  open_request_t* request = data;
+  if (request == NULL) {
+    return;
+  }
+
+  g_free(request->path);
+  g_free(request->password);
+  g_free(request);
+}
+
+static double*
+load_page_sizes(PopplerDocument* poppler_document, unsigned int number_of_pages,
+    GTask* task)
+{
+  if (number_of_pages == 0) {
+    return NULL;
+  }
+
+  double* page_sizes = g_malloc(2 * sizeof(double) * number_of_pages);
+  for (unsigned int i = 0; i < number_of_pages; i++) {
+    PopplerPage* poppler_page = pdf_task_cancelled(task) == false ?
+      poppler_document_get_page(poppler_document, i) : NULL;
+    if (poppler_page == NULL) {
+      g_free(page_sizes);
+      return NULL;
+    }
+
+    poppler_page_get_size(poppler_page, &page_sizes[2 * i], &page_sizes[2 * i + 1]);
+    g_object_unref(poppler_page);
+    pdf_task_progress(task, i + 1, number_of_pages);
+  }
+
+  return page_sizes;
+}
+
+static void
+page_size_loader_start(pdf_document_t* pdf_document)
+{
+  PopplerPage* poppler_page = poppler_document_get_page(pdf_document->poppler_document, 0);
+  if (poppler_page == NULL) {
+    return;
+  }
+
+  /* until the real sizes arrive, every page is assumed to be as large as
+   * the first one */
+  double width  = 0;
+  double height = 0;
+  poppler_page_get_size(poppler_page, &width, &height);
+  g_object_unref(poppler_page);
+
+  const unsigned int number_of_pages = pdf_document->number_of_pages;
+  pdf_document->page_sizes = g_malloc(2 * sizeof(double) * number_of_pages);
+  for (unsigned int i = 0; i < number_of_pages; i++) {
+    pdf_document->page_sizes[2 * i]     = width;
+    pdf_document->page_sizes[2 * i + 1] = height;
+  }
+  pdf_document->page_sizes_loaded  = 1;
+  pdf_document->page_sizes_applied = 1;
+
+  pdf_document->page_size_loader = g_thread_new("pdf-page-sizes",
+      page_size_loader, pdf_document);
+  pdf_document->page_size_source = g_timeout_add(PAGE_SIZE_UPDATE_INTERVAL,
+      apply_page_sizes, pdf_document);
+}
+
+static void
+page_size_loader_stop(pdf_document_t* pdf_document)
+{
+  if (pdf_document->page_size_loader != NULL) {
+    g_atomic_int_set(&pdf_document->page_size_loader_cancelled, 1);
+    g_thread_join(pdf_document->page_size_loader);
+    pdf_document->page_size_loader = NULL;
+  }
+
+  if (pdf_document->page_size_source != 0) {
+    g_source_remove(pdf_document->page_size_source);
+    pdf_document->page_size_source = 0;
+  }
+}
+
+static gpointer
+page_size_loader(gpointer data)
+{
+  pdf_document_t* pdf_document = data;
+
+  /* the pages are loaded from the document of the viewer instead of a copy,
+   * which would parse the file a second time. The lock is only held for one
+   * page at a time, so renders are not held up. */
+  unsigned int failed = 0;
+  for (unsigned int i = 1; i < pdf_document->number_of_pages; i++) {
+    if (g_atomic_int_get(&pdf_document->page_size_loader_cancelled) != 0) {
+      break;
+    }
+
+    pdf_document_lock(pdf_document);
+    PopplerPage* poppler_page = poppler_document_get_page(pdf_document->poppler_document, i);
+    double width  = 0;
+    double height = 0;
+    if (poppler_page != NULL) {
+      poppler_page_get_size(poppler_page, &width, &height);
+      g_object_unref(poppler_page);
+    }
+    pdf_document_unlock(pdf_document);
+
+    /* pages that fail to load keep the size of the first page */
+    g_mutex_lock(&pdf_document->page_sizes_lock);
+    if (poppler_page != NULL) {
+      pdf_document->page_sizes[2 * i]     = width;
+      pdf_document->page_sizes[2 * i + 1] = height;
+    } else {
+      failed++;
+    }
+    pdf_document->page_sizes_loaded = i + 1;
+    g_mutex_unlock(&pdf_document->page_sizes_lock);
+  }
+
+  if (failed > 0) {
+    girara_warning("Failed to load the size of %u pages, assuming the size of the first page",
+        failed);
+    /* the guessed sizes are not written to the cache */
+    return NULL;
+  }
+
+  /* a cancelled loader has not seen every page */
+  if (pdf_document->cache_key != NULL &&
+      g_atomic_int_get(&pdf_document->page_size_loader_cancelled) == 0) {
+    pdf_cache_file_save(pdf_document->cache_key, pdf_document->number_of_pages,
+        pdf_document->page_sizes);
+  }
+
+  return NULL;
+}
+
+static gboolean
+apply_page_sizes(gpointer data)
+{
+  pdf_document_t* pdf_document = data;
+
+  g_mutex_lock(&pdf_document->page_sizes_lock);
+
+  for (unsigned int i = pdf_document->page_sizes_applied; i <
+      pdf_document->page_sizes_loaded; i++) {
+    zathura_page_t* page = zathura_document_get_page(pdf_document->document, i);
+    if (page != NULL) {
+      zathura_page_set_width(page, pdf_document->page_sizes[2 * i]);
+      zathura_page_set_height(page, pdf_document->page_sizes[2 * i + 1]);
+    }
+  }
+  const bool changed = pdf_document->page_sizes_applied != pdf_document->page_sizes_loaded;
+  pdf_document->page_sizes_applied = pdf_document->page_sizes_loaded;
+
+  const bool done = pdf_document->page_sizes_loaded == pdf_document->number_of_pages;
+
+  g_mutex_unlock(&pdf_document->page_sizes_lock);
+
+  if (changed == true) {
+    /* zathura only recomputes the positions of the pages when the layout is
+     * set */
+    zathura_document_t* document = pdf_document->document;
+    zathura_document_set_page_layout(document,
+        zathura_document_get_page_padding(document),
+        zathura_document_get_pages_per_row(document),
+        zathura_document_get_first_page_column(document));
+  }
+
+  if (done == true) {
+    pdf_document->page_size_source = 0;
+    return G_SOURCE_REMOVE;
+  }
+
+  return G_SOURCE_CONTINUE;
+}
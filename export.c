@@ -0,0 +1,150 @@
+/* See LICENSE file for license and copyright information */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <girara/utils.h>
+
+#include "plugin.h"
+#include "workers.h"
+
+/**
+ * Text of a page
+ */
+typedef struct export_page_s {
+  char* text; /**< Text of the page */
+  PopplerRectangle* text_layout; /**< Rectangle of every character or NULL */
+  guint text_layout_length; /**< Number of rectangles in text_layout */
+} export_page_t;
+
+/**
+ * Options of the export and the function receiving the text
+ */
+typedef struct export_job_s {
+  bool text_layout; /**< Set if the text layout is extracted */
+  pdf_export_text_t callback; /**< Function called with the text of every page */
+  void* data; /**< Custom data passed to callback */
+} export_job_t;
+
+static void* extract_page(PopplerDocument* poppler_document, unsigned int
+    index, void* data);
+static bool pass_page(unsigned int index, void* result, void* data);
+static void export_page_free(void* data);
+static bool write_page(unsigned int index, const char* text, const
+    PopplerRectangle* text_layout, guint text_layout_length, void* data);
+
+zathura_error_t
+pdf_document_export_text(pdf_document_t* pdf_document, bool text_layout,
+    pdf_export_text_t callback, void* data)
+{
+  if (pdf_document == NULL || callback == NULL) {
+    return ZATHURA_ERROR_INVALID_ARGUMENTS;
+  }
+
+  if (pdf_document->number_of_pages == 0) {
+    return ZATHURA_ERROR_OK;
+  }
+
+  export_job_t job = { text_layout, callback, data };
+
+  return pdf_workers_run(pdf_document, "pdf-export", 0,
+      pdf_document->number_of_pages - 1, extract_page, pass_page,
+      export_page_free, &job);
+}
+
+zathura_error_t
+pdf_document_export_text_to_fd(pdf_document_t* pdf_document, int fd)
+{
+  if (fd < 0) {
+    return ZATHURA_ERROR_INVALID_ARGUMENTS;
+  }
+
+  return pdf_document_export_text(pdf_document, false, write_page, &fd);
+}
+
+static void*
+extract_page(PopplerDocument* poppler_document, unsigned int index, void* data)
+{
+  export_job_t* job = data;
+
+  PopplerPage* poppler_page = poppler_document_get_page(poppler_document, index);
+  if (poppler_page == NULL) {
+    girara_warning("Failed to load page %u for the text export", index);
+    return NULL;
+  }
+
+  /* pages without text give an empty string, NULL means poppler failed */
+  char* text = poppler_page_get_text(poppler_page);
+  if (text == NULL) {
+    girara_warning("Failed to extract the text of page %u", index);
+    g_object_unref(poppler_page);
+    return NULL;
+  }
+
+  export_page_t* page = g_malloc0(sizeof(export_page_t));
+  page->text = text;
+
+  if (job->text_layout == true &&
+      poppler_page_get_text_layout(poppler_page, &page->text_layout,
+        &page->text_layout_length) == FALSE) {
+    page->text_layout        = NULL;
+    page->text_layout_length = 0;
+  }
+
+  g_object_unref(poppler_page);
+
+  return page;
+}
+
+static bool
+pass_page(unsigned int index, void* result, void* data)
+{
+  export_page_t* page = result;
+  export_job_t* job   = data;
+
+  return job->callback(index, page->text, page->text_layout,
+      page->text_layout_length, job->data);
+}
+
+static void
+export_page_free(void* data)
+{
+  export_page_t* page = data;
+
+  g_free(page->text);
+  g_free(page->text_layout);
+  g_free(page);
+}
+
+static bool
+write_page(unsigned int index, const char* text, const PopplerRectangle*
+    text_layout, guint text_layout_length, void* data)
+{
+  const int fd = *(int*) data;
+
+  /* pages are separated by form feeds like in the output of pdftotext */
+  const char* buffers[2] = { text, "\f" };
+  for (unsigned int i = 0; i < G_N_ELEMENTS(buffers); i++) {
+    const char* buffer = buffers[i];
+    size_t length      = strlen(buffer);
+
+    while (length > 0) {
+      const ssize_t written = write(fd, buffer, length);
+      if (written < 0 && errno == EINTR) {
+        continue;
+      } else if (written < 0) {
+        girara_error("Failed to write the text of page %u: %s", index,
+            g_strerror(errno));
+        return false;
+      }
+
+      buffer += written;
+      length -= written;
+    }
+  }
+
+  return true;
+}
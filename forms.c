@@ -3,7 +3,7 @@
 #include "plugin.h"
 
 girara_list_t*
-pdf_page_form_fields_get(zathura_page_t* page, PopplerPage* poppler_page,
+pdf_page_form_fields_get(zathura_page_t* page, pdf_page_t* pdf_page,
     zathura_error_t* error)
 {
   if (error != NULL) {
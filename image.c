@@ -6,17 +6,25 @@
 static void pdf_zathura_image_free(zathura_image_t* image);
 
 girara_list_t*
-pdf_page_images_get(zathura_page_t* page, PopplerPage* poppler_page, zathura_error_t* error)
+pdf_page_images_get(zathura_page_t* page, pdf_page_t* pdf_page, zathura_error_t* error)
 {
-  if (page == NULL || poppler_page == NULL) {
+  if (page == NULL || pdf_page == NULL) {
     if (error != NULL) {
       *error = ZATHURA_ERROR_INVALID_ARGUMENTS;
     }
     goto error_ret;
   }
 
-  girara_list_t* list  = NULL;
-  GList* image_mapping = NULL;
+  girara_list_t* list       = NULL;
+  GList* image_mapping      = NULL;
+  PopplerPage* poppler_page = pdf_page_get_poppler_page(pdf_page);
+
+  if (poppler_page == NULL) {
+    if (error != NULL) {
+      *error = ZATHURA_ERROR_UNKNOWN;
+    }
+    goto error_ret;
+  }
 
   image_mapping = poppler_page_get_image_mapping(poppler_page);
   if (image_mapping == NULL || g_list_length(image_mapping) == 0) {
@@ -57,6 +65,7 @@ pdf_page_images_get(zathura_page_t* page, PopplerPage* poppler_page, zathura_err
   }
 
   poppler_page_free_image_mapping(image_mapping);
+  g_object_unref(poppler_page);
 
   return list;
 
@@ -70,25 +79,37 @@ error_free:
     poppler_page_free_image_mapping(image_mapping);
   }
 
+  g_object_unref(poppler_page);
+
 error_ret:
 
   return NULL;
 }
 
 cairo_surface_t*
-pdf_page_image_get_cairo(zathura_page_t* page, PopplerPage* poppler_page,
+pdf_page_image_get_cairo(zathura_page_t* page, pdf_page_t* pdf_page,
     zathura_image_t* image, zathura_error_t* error)
 {
-  if (page == NULL || poppler_page == NULL || image == NULL || image->data == NULL) {
+  if (page == NULL || pdf_page == NULL || image == NULL || image->data == NULL) {
     if (error != NULL) {
       *error = ZATHURA_ERROR_INVALID_ARGUMENTS;
     }
     goto error_ret;
   }
 
+  PopplerPage* poppler_page = pdf_page_get_poppler_page(pdf_page);
+  if (poppler_page == NULL) {
+    if (error != NULL) {
+      *error = ZATHURA_ERROR_UNKNOWN;
+    }
+    goto error_ret;
+  }
+
   gint* image_id = (gint*) image->data;
 
   cairo_surface_t* surface = poppler_page_get_image(poppler_page, *image_id);
+  g_object_unref(poppler_page);
+
   if (surface == NULL) {
     if (error != NULL) {
       *error = ZATHURA_ERROR_UNKNOWN;
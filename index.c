@@ -2,21 +2,65 @@
 
 #include "plugin.h"
 #include "utils.h"
+#include "outline.h"
+#include "task.h"
+
+static girara_tree_node_t* generate_index(pdf_document_t* pdf_document, GTask*
+    task, zathura_error_t* error);
+static void index_thread(GTask* task, gpointer source, gpointer task_data,
+    GCancellable* cancellable);
+static bool build_index(pdf_document_t* pdf_document, girara_tree_node_t*
+    root, PopplerIndexIter* iter, unsigned int depth, GArray* items, GTask*
+    task);
+static void set_outline(pdf_document_t* pdf_document, GArray* items);
 
-static void build_index(PopplerDocument* poppler_document, girara_tree_node_t*
-    root, PopplerIndexIter* iter);
+girara_tree_node_t*
+pdf_document_index_generate(zathura_document_t* document, pdf_document_t* pdf_document, zathura_error_t* error)
+{
+  if (document == NULL || pdf_document == NULL) {
+    if (error != NULL) {
+      *error = ZATHURA_ERROR_INVALID_ARGUMENTS;
+    }
+    return NULL;
+  }
+
+  return generate_index(pdf_document, NULL, error);
+}
+
+void
+pdf_document_index_generate_async(pdf_document_t* pdf_document, GCancellable*
+    cancellable, pdf_progress_t progress, void* progress_data,
+    GAsyncReadyCallback callback, void* data)
+{
+  GTask* task = pdf_task_new(pdf_document, NULL, false, cancellable, progress,
+      progress_data, callback, data);
+
+  if (pdf_document == NULL) {
+    pdf_task_return_error(task, ZATHURA_ERROR_INVALID_ARGUMENTS);
+  } else {
+    g_task_run_in_thread(task, index_thread);
+  }
+
+  g_object_unref(task);
+}
 
 girara_tree_node_t*
-pdf_document_index_generate(zathura_document_t* document, PopplerDocument* poppler_document, zathura_error_t* error)
+pdf_document_index_generate_finish(GAsyncResult* result, zathura_error_t* error)
 {
-  if (document == NULL || poppler_document == NULL) {
+  if (result == NULL) {
     if (error != NULL) {
       *error = ZATHURA_ERROR_INVALID_ARGUMENTS;
     }
     return NULL;
   }
 
-  PopplerIndexIter* iter = poppler_index_iter_new(poppler_document);
+  return pdf_task_finish(result, error);
+}
+
+static girara_tree_node_t*
+generate_index(pdf_document_t* pdf_document, GTask* task, zathura_error_t* error)
+{
+  PopplerIndexIter* iter = poppler_index_iter_new(pdf_document->poppler_document);
 
   if (iter == NULL) {
     if (error != NULL) {
@@ -27,20 +71,99 @@ pdf_document_index_generate(zathura_document_t* document, PopplerDocument* poppl
 
   girara_tree_node_t* root = girara_node_new(zathura_index_element_new("ROOT"));
   // girara_node_set_free_function(root, (girara_free_function_t) zathura_index_element_free);
-  build_index(poppler_document, root, iter);
-
+  GArray* items = g_array_new(FALSE, FALSE, sizeof(pdf_outline_item_t));
+  const bool complete = build_index(pdf_document, root, iter, 0, items, task);
   poppler_index_iter_free(iter);
+
+  if (complete == false) {
+    for (unsigned int i = 0; i < items->len; i++) {
+      g_free(g_array_index(items, pdf_outline_item_t, i).title);
+    }
+    g_array_free(items, TRUE);
+    girara_node_free(root);
+
+    if (error != NULL) {
+      *error = ZATHURA_ERROR_UNKNOWN;
+    }
+    return NULL;
+  }
+
+  pdf_task_progress(task, items->len, items->len);
+
+  /* the lookup tables are built alongside the tree */
+  g_mutex_lock(&pdf_document->outline_lock);
+  set_outline(pdf_document, items);
+  g_mutex_unlock(&pdf_document->outline_lock);
+
   return root;
 }
 
 static void
-build_index(PopplerDocument* poppler_document, girara_tree_node_t* root, PopplerIndexIter* iter)
+index_thread(GTask* task, gpointer source, gpointer task_data, GCancellable*
+    cancellable)
+{
+  pdf_document_t* pdf_document = pdf_task_get_object(task);
+  zathura_error_t error        = ZATHURA_ERROR_OK;
+
+  pdf_document_lock(pdf_document);
+  girara_tree_node_t* root = generate_index(pdf_document, task, &error);
+  pdf_document_unlock(pdf_document);
+
+  if (root == NULL) {
+    pdf_task_return_error(task, error);
+  } else {
+    pdf_task_return(task, root, (GDestroyNotify) girara_node_free);
+  }
+}
+
+pdf_outline_t*
+pdf_document_get_outline(pdf_document_t* pdf_document)
+{
+  if (pdf_document->outline != NULL) {
+    return pdf_document->outline;
+  }
+
+  PopplerIndexIter* iter = poppler_index_iter_new(pdf_document->poppler_document);
+  if (iter == NULL) {
+    return NULL;
+  }
+
+  GArray* items = g_array_new(FALSE, FALSE, sizeof(pdf_outline_item_t));
+  build_index(pdf_document, NULL, iter, 0, items, NULL);
+  set_outline(pdf_document, items);
+
+  poppler_index_iter_free(iter);
+  return pdf_document->outline;
+}
+
+static void
+set_outline(pdf_document_t* pdf_document, GArray* items)
+{
+  pdf_outline_free(pdf_document->outline);
+  pdf_document->outline = pdf_outline_new(items);
+}
+
+static bool
+build_index(pdf_document_t* pdf_document, girara_tree_node_t* root,
+    PopplerIndexIter* iter, unsigned int depth, GArray* items, GTask* task)
 {
-  if (poppler_document == NULL || root == NULL || iter == NULL) {
-    return;
+  PopplerDocument* poppler_document = pdf_document->poppler_document;
+  if (poppler_document == NULL || iter == NULL) {
+    return true;
   }
 
   do {
+    if (task != NULL) {
+      if (pdf_task_cancelled(task) == true) {
+        return false;
+      }
+
+      /* let other users of the document in between entries */
+      pdf_document_unlock(pdf_document);
+      pdf_task_progress(task, items->len, 0);
+      pdf_document_lock(pdf_document);
+    }
+
     PopplerAction* action = poppler_index_iter_get_action(iter);
 
     if (action == NULL) {
@@ -64,16 +187,38 @@ build_index(PopplerDocument* poppler_document, girara_tree_node_t* root, Poppler
       continue;
     }
 
-    poppler_action_free(action);
+    pdf_outline_item_t item = {
+      .title = g_strdup(action->any.title),
+      .page  = G_MAXUINT,
+      .depth = depth
+    };
+    if (zathura_link_get_type(index_element->link) == ZATHURA_LINK_GOTO_DEST) {
+      item.page = zathura_link_get_target(index_element->link).page_number;
+    }
+    g_array_append_val(items, item);
 
-    girara_tree_node_t* node = girara_node_append_data(root, index_element);
-    PopplerIndexIter* child  = poppler_index_iter_get_child(iter);
+    poppler_action_free(action);
 
-    if (child != NULL) {
-      build_index(poppler_document, node, child);
+    /* without a tree only the lookup tables are built */
+    girara_tree_node_t* node = NULL;
+    if (root != NULL) {
+      node = girara_node_append_data(root, index_element);
+    } else {
+      zathura_index_element_free(index_element);
     }
 
+    PopplerIndexIter* child = poppler_index_iter_get_child(iter);
+
+    const bool complete = child == NULL ||
+      build_index(pdf_document, node, child, depth + 1, items, task);
+
     poppler_index_iter_free(child);
 
+    if (complete == false) {
+      return false;
+    }
+
   } while (poppler_index_iter_next(iter));
+
+  return true;
 }
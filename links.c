@@ -2,21 +2,30 @@
 
 #include "plugin.h"
 #include "utils.h"
+#include "pagecache.h"
 
 girara_list_t*
-pdf_page_links_get(zathura_page_t* page, PopplerPage* poppler_page, zathura_error_t* error)
+pdf_page_links_get(zathura_page_t* page, pdf_page_t* pdf_page, zathura_error_t* error)
 {
-  if (page == NULL || poppler_page == NULL) {
+  if (page == NULL || pdf_page == NULL) {
     if (error != NULL) {
       *error = ZATHURA_ERROR_INVALID_ARGUMENTS;
     }
     goto error_ret;
   }
 
-  girara_list_t* list = NULL;
-  GList* link_mapping = NULL;
+  girara_list_t* list       = NULL;
+  GList* link_mapping       = NULL;
+  PopplerPage* poppler_page = pdf_page_get_poppler_page(pdf_page);
 
-  link_mapping = poppler_page_get_link_mapping(poppler_page);
+  if (poppler_page == NULL) {
+    if (error != NULL) {
+      *error = ZATHURA_ERROR_UNKNOWN;
+    }
+    goto error_ret;
+  }
+
+  link_mapping = pdf_page_cache_get_link_mapping(pdf_page, poppler_page);
   if (link_mapping == NULL || g_list_length(link_mapping) == 0) {
     if (error != NULL) {
       *error = ZATHURA_ERROR_UNKNOWN;
@@ -33,8 +42,7 @@ pdf_page_links_get(zathura_page_t* page, PopplerPage* poppler_page, zathura_erro
     goto error_free;
   }
 
-  zathura_document_t* zathura_document = (zathura_document_t*) zathura_page_get_document(page);
-  PopplerDocument* poppler_document    = zathura_document_get_data(zathura_document);
+  PopplerDocument* poppler_document = pdf_page->document->poppler_document;
 
   const double page_height = zathura_page_get_height(page);
 
@@ -58,6 +66,7 @@ pdf_page_links_get(zathura_page_t* page, PopplerPage* poppler_page, zathura_erro
   }
 
   poppler_page_free_link_mapping(link_mapping);
+  g_object_unref(poppler_page);
 
   return list;
 
@@ -71,6 +80,8 @@ error_free:
     poppler_page_free_link_mapping(link_mapping);
   }
 
+  g_object_unref(poppler_page);
+
 error_ret:
 
   return NULL;
@@ -0,0 +1,315 @@
+/* See LICENSE file for license and copyright information */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <glib-unix.h>
+#endif
+
+#include <girara/utils.h>
+
+#include "plugin.h"
+#include "memory.h"
+
+#define MEMORY_LIMIT_DEFAULT 512
+
+/* Stall threshold and window of the pressure trigger in microseconds. Windows
+ * of at least 2s are also accepted from unprivileged processes. */
+#define PRESSURE_TRIGGER "some 200000 2000000"
+
+typedef struct memory_budget_s {
+  GMutex lock; /**< Lock for entries, usage and the trimming flag of entries */
+  GCond trimmed; /**< Signalled when entries have been trimmed */
+  GQueue entries; /**< Entries, most recently used first */
+  size_t usage; /**< Accounted memory */
+  size_t limit; /**< Memory budget or 0 if there is no limit */
+
+  GMutex monitor_lock; /**< Lock for the members below */
+  unsigned int users; /**< Number of open documents */
+  GThread* monitor; /**< Thread waiting for memory pressure or NULL */
+  int monitor_stop[2]; /**< Pipe that stops the monitor when written to */
+} memory_budget_t;
+
+static memory_budget_t* memory_budget_get(void);
+static void untrack_locked(memory_budget_t* budget, pdf_memory_entry_t* entry);
+static void wait_trimmed_locked(memory_budget_t* budget, pdf_memory_entry_t* entry);
+static void trim_unlock(memory_budget_t* budget, size_t limit);
+#ifdef __linux__
+static int pressure_monitor_open(void);
+static gpointer pressure_monitor(gpointer data);
+#endif
+
+void
+pdf_memory_entry_init(pdf_memory_entry_t* entry, pdf_memory_trim_function_t
+    trim, void* data)
+{
+  memset(entry, 0, sizeof(pdf_memory_entry_t));
+  entry->link.data = entry;
+  entry->trim      = trim;
+  entry->data      = data;
+}
+
+void
+pdf_memory_touch(pdf_memory_entry_t* entry, size_t size)
+{
+  if (entry == NULL) {
+    return;
+  }
+
+  memory_budget_t* budget = memory_budget_get();
+
+  g_mutex_lock(&budget->lock);
+
+  /* the state accounted for now must not be dropped by a trim that started
+   * before it was created */
+  wait_trimmed_locked(budget, entry);
+  untrack_locked(budget, entry);
+
+  g_queue_push_head_link(&budget->entries, &entry->link);
+  entry->tracked = true;
+  entry->size    = size;
+  budget->usage += size;
+
+  if (budget->limit != 0 && budget->usage > budget->limit) {
+    trim_unlock(budget, budget->limit);
+  } else {
+    g_mutex_unlock(&budget->lock);
+  }
+}
+
+void
+pdf_memory_remove(pdf_memory_entry_t* entry)
+{
+  if (entry == NULL) {
+    return;
+  }
+
+  memory_budget_t* budget = memory_budget_get();
+
+  g_mutex_lock(&budget->lock);
+  wait_trimmed_locked(budget, entry);
+  untrack_locked(budget, entry);
+  g_mutex_unlock(&budget->lock);
+}
+
+void
+pdf_memory_trim(size_t limit)
+{
+  memory_budget_t* budget = memory_budget_get();
+
+  g_mutex_lock(&budget->lock);
+  trim_unlock(budget, limit);
+}
+
+void
+pdf_memory_ref(void)
+{
+  memory_budget_t* budget = memory_budget_get();
+
+  g_mutex_lock(&budget->monitor_lock);
+#ifdef __linux__
+  if (budget->users == 0) {
+    const int fd = pressure_monitor_open();
+    if (fd >= 0 && g_unix_open_pipe(budget->monitor_stop, FD_CLOEXEC, NULL) == FALSE) {
+      close(fd);
+    } else if (fd >= 0) {
+      budget->monitor = g_thread_new("pdf-memory-pressure", pressure_monitor,
+          GINT_TO_POINTER(fd));
+    }
+  }
+#endif
+  budget->users++;
+  g_mutex_unlock(&budget->monitor_lock);
+}
+
+void
+pdf_memory_unref(void)
+{
+  memory_budget_t* budget = memory_budget_get();
+
+  g_mutex_lock(&budget->monitor_lock);
+  budget->users--;
+#ifdef __linux__
+  if (budget->users == 0 && budget->monitor != NULL) {
+    /* the monitor takes the budget lock, but never the monitor lock */
+    if (write(budget->monitor_stop[1], "", 1) < 0) {
+      girara_warning("Failed to stop the memory pressure monitor");
+    }
+    g_thread_join(budget->monitor);
+    budget->monitor = NULL;
+    close(budget->monitor_stop[0]);
+    close(budget->monitor_stop[1]);
+  }
+#endif
+  g_mutex_unlock(&budget->monitor_lock);
+}
+
+static memory_budget_t*
+memory_budget_get(void)
+{
+  static memory_budget_t* budget = NULL;
+
+  if (g_once_init_enter(&budget)) {
+    memory_budget_t* new_budget = g_malloc0(sizeof(memory_budget_t));
+    g_mutex_init(&new_budget->lock);
+    g_cond_init(&new_budget->trimmed);
+    g_queue_init(&new_budget->entries);
+    g_mutex_init(&new_budget->monitor_lock);
+
+    /* a limit of 0 disables the budget */
+    guint64 limit = MEMORY_LIMIT_DEFAULT;
+    const char* value = g_getenv(PDF_MEMORY_LIMIT_OPTION);
+    if (value != NULL && *value != '\0') {
+      limit = g_ascii_strtoull(value, NULL, 10);
+    }
+    new_budget->limit = MIN(limit, G_MAXSIZE / (1024 * 1024)) * 1024 * 1024;
+
+    g_once_init_leave(&budget, (gsize) new_budget);
+  }
+
+  return budget;
+}
+
+static void
+untrack_locked(memory_budget_t* budget, pdf_memory_entry_t* entry)
+{
+  if (entry->tracked == false) {
+    return;
+  }
+
+  g_queue_unlink(&budget->entries, &entry->link);
+  budget->usage -= entry->size;
+  entry->tracked = false;
+  entry->size    = 0;
+}
+
+static void
+wait_trimmed_locked(memory_budget_t* budget, pdf_memory_entry_t* entry)
+{
+  while (entry->trimming == true) {
+    g_cond_wait(&budget->trimmed, &budget->lock);
+  }
+}
+
+static void
+trim_unlock(memory_budget_t* budget, size_t limit)
+{
+  const size_t usage = budget->usage;
+
+  /* entries are taken out of the budget under the lock, but trimmed after
+   * releasing it, so trim functions may take locks of their own and other
+   * threads can keep using the budget meanwhile */
+  GList* trimmed = NULL;
+  while (budget->usage > limit && g_queue_is_empty(&budget->entries) == FALSE) {
+    pdf_memory_entry_t* entry = g_queue_peek_tail(&budget->entries);
+    untrack_locked(budget, entry);
+    entry->trimming = true;
+    trimmed = g_list_prepend(trimmed, entry);
+  }
+
+  const size_t released = usage - budget->usage;
+
+  g_mutex_unlock(&budget->lock);
+
+  if (trimmed == NULL) {
+    return;
+  }
+
+  for (GList* link = trimmed; link != NULL; link = link->next) {
+    pdf_memory_entry_t* entry = link->data;
+    entry->trim(entry->data);
+  }
+
+  g_mutex_lock(&budget->lock);
+  for (GList* link = trimmed; link != NULL; link = link->next) {
+    pdf_memory_entry_t* entry = link->data;
+    entry->trimming = false;
+  }
+  g_cond_broadcast(&budget->trimmed);
+  g_mutex_unlock(&budget->lock);
+
+  g_list_free(trimmed);
+
+  girara_debug("Trimmed %zu bytes of plugin state", released);
+}
+
+#ifdef __linux__
+static int
+pressure_monitor_open(void)
+{
+  char* paths[2] = { NULL, g_strdup("/proc/pressure/memory") };
+
+  /* prefer the pressure of our own cgroup so that limits set on it are
+   * taken into account */
+  char* cgroups = NULL;
+  if (g_file_get_contents("/proc/self/cgroup", &cgroups, NULL, NULL) == TRUE) {
+    char** lines = g_strsplit(cgroups, "\n", -1);
+    for (char** line = lines; *line != NULL; line++) {
+      if (g_str_has_prefix(*line, "0::") == TRUE) {
+        paths[0] = g_build_filename("/sys/fs/cgroup", *line + 3, "memory.pressure", NULL);
+        break;
+      }
+    }
+    g_strfreev(lines);
+    g_free(cgroups);
+  }
+
+  int fd = -1;
+  for (unsigned int i = 0; i < G_N_ELEMENTS(paths) && fd < 0; i++) {
+    if (paths[i] == NULL) {
+      continue;
+    }
+
+    fd = open(paths[i], O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd >= 0 && write(fd, PRESSURE_TRIGGER, strlen(PRESSURE_TRIGGER) + 1) < 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+
+  g_free(paths[0]);
+  g_free(paths[1]);
+
+  return fd;
+}
+
+static gpointer
+pressure_monitor(gpointer data)
+{
+  memory_budget_t* budget = memory_budget_get();
+
+  struct pollfd fds[2] = {
+    { .fd = GPOINTER_TO_INT(data), .events = POLLPRI },
+    { .fd = budget->monitor_stop[0], .events = POLLIN }
+  };
+
+  while (true) {
+    if (poll(fds, G_N_ELEMENTS(fds), -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+
+    if ((fds[0].revents & POLLERR) != 0 || fds[1].revents != 0) {
+      break;
+    }
+
+    if ((fds[0].revents & POLLPRI) != 0) {
+      g_mutex_lock(&budget->lock);
+      girara_debug("Memory pressure, trimming plugin state");
+      trim_unlock(budget, budget->usage / 2);
+    }
+  }
+
+  close(fds[0].fd);
+
+  return NULL;
+}
+#endif
@@ -0,0 +1,87 @@
+/* See LICENSE file for license and copyright information */
+
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <glib.h>
+
+/**
+ * Name of the environment variable that sets the memory budget in MiB. A
+ * budget of 0 disables the limit.
+ */
+#define PDF_MEMORY_LIMIT_OPTION "ZATHURA_PDF_POPPLER_MEMORY_LIMIT"
+
+/**
+ * Function that releases the memory accounted for by an entry
+ *
+ * @param data Data of the entry
+ */
+typedef void (*pdf_memory_trim_function_t)(void* data);
+
+/**
+ * State kept alive by the plugin that can be dropped and recreated on demand.
+ * Entries are embedded into the structure owning the state.
+ */
+typedef struct pdf_memory_entry_s {
+  GList link; /**< Position in the list of entries */
+  bool tracked; /**< Set while the entry is in the list of entries */
+  bool trimming; /**< Set while the trim function of the entry runs */
+  size_t size; /**< Accounted size in bytes */
+  pdf_memory_trim_function_t trim; /**< Function releasing the state */
+  void* data; /**< Argument for trim */
+} pdf_memory_entry_t;
+
+/**
+ * Initializes an entry
+ *
+ * @param entry The entry
+ * @param trim Function releasing the state
+ * @param data Argument for trim
+ */
+void pdf_memory_entry_init(pdf_memory_entry_t* entry,
+    pdf_memory_trim_function_t trim, void* data);
+
+/**
+ * Marks the state of an entry as used. Entries that are not tracked yet are
+ * added to the budget. If the budget is exceeded afterwards, the least
+ * recently used entries are trimmed. Must not be called while holding a lock
+ * that the trim function of any entry takes. If the entry is being trimmed by
+ * another thread, the call waits until the trim function returned.
+ *
+ * @param entry The entry
+ * @param size Current size of the state in bytes
+ */
+void pdf_memory_touch(pdf_memory_entry_t* entry, size_t size);
+
+/**
+ * Removes an entry from the budget without trimming it. After this function
+ * returns, the trim function of the entry is not running and will not be
+ * called anymore.
+ *
+ * @param entry The entry
+ */
+void pdf_memory_remove(pdf_memory_entry_t* entry);
+
+/**
+ * Trims least recently used entries until the accounted memory is below the
+ * given limit
+ *
+ * @param limit Limit in bytes
+ */
+void pdf_memory_trim(size_t limit);
+
+/**
+ * Registers an open document. The memory pressure monitor runs while at least
+ * one document is registered.
+ */
+void pdf_memory_ref(void);
+
+/**
+ * Unregisters an open document. The memory pressure monitor is stopped with
+ * the last one.
+ */
+void pdf_memory_unref(void);
+
+#endif // MEMORY_H
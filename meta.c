@@ -3,20 +3,26 @@
 #include <string.h>
 
 #include "plugin.h"
+#include "task.h"
 
 #define LENGTH(x) (sizeof(x)/sizeof((x)[0]))
 
+static void information_thread(GTask* task, gpointer source, gpointer
+    task_data, GCancellable* cancellable);
+
 girara_list_t*
-pdf_document_get_information(zathura_document_t* document, PopplerDocument*
-    poppler_document, zathura_error_t* error)
+pdf_document_get_information(zathura_document_t* document, pdf_document_t*
+    pdf_document, zathura_error_t* error)
 {
-  if (document == NULL || poppler_document == NULL) {
+  if (document == NULL || pdf_document == NULL) {
     if (error != NULL) {
       *error = ZATHURA_ERROR_INVALID_ARGUMENTS;
     }
     return NULL;
   }
 
+  PopplerDocument* poppler_document = pdf_document->poppler_document;
+
   girara_list_t* list = zathura_document_information_entry_list_new();
   if (list == NULL) {
     return NULL;
@@ -73,3 +79,56 @@ pdf_document_get_information(zathura_document_t* document, PopplerDocument*
 
   return list;
 }
+
+void
+pdf_document_get_information_async(pdf_document_t* pdf_document, GCancellable*
+    cancellable, GAsyncReadyCallback callback, void* data)
+{
+  GTask* task = pdf_task_new(pdf_document, NULL, false, cancellable, NULL,
+      NULL, callback, data);
+
+  if (pdf_document == NULL) {
+    pdf_task_return_error(task, ZATHURA_ERROR_INVALID_ARGUMENTS);
+  } else {
+    g_task_run_in_thread(task, information_thread);
+  }
+
+  g_object_unref(task);
+}
+
+girara_list_t*
+pdf_document_get_information_finish(GAsyncResult* result, zathura_error_t* error)
+{
+  if (result == NULL) {
+    if (error != NULL) {
+      *error = ZATHURA_ERROR_INVALID_ARGUMENTS;
+    }
+    return NULL;
+  }
+
+  return pdf_task_finish(result, error);
+}
+
+static void
+information_thread(GTask* task, gpointer source, gpointer task_data,
+    GCancellable* cancellable)
+{
+  pdf_document_t* pdf_document = pdf_task_get_object(task);
+  zathura_error_t error        = ZATHURA_ERROR_UNKNOWN;
+
+  if (pdf_task_cancelled(task) == true) {
+    pdf_task_return_error(task, error);
+    return;
+  }
+
+  pdf_document_lock(pdf_document);
+  girara_list_t* list = pdf_document_get_information(pdf_document->document,
+      pdf_document, &error);
+  pdf_document_unlock(pdf_document);
+
+  if (list == NULL) {
+    pdf_task_return_error(task, error);
+  } else {
+    pdf_task_return(task, list, (GDestroyNotify) girara_list_free);
+  }
+}
@@ -0,0 +1,333 @@
+/* See LICENSE file for license and copyright information */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "outline.h"
+
+/**
+ * Entry of the table sorted by page
+ */
+typedef struct outline_page_s {
+  unsigned int page; /**< Index of the target page */
+  unsigned int position; /**< Position of the entry in document order */
+} outline_page_t;
+
+/**
+ * Entry of a table sorted by a string
+ */
+typedef struct outline_key_s {
+  char* key; /**< Key of the entry */
+  unsigned int position; /**< Position of the entry */
+} outline_key_t;
+
+struct pdf_outline_s {
+  GArray* items; /**< pdf_outline_item_t in document order */
+  outline_page_t* by_page; /**< Entries with a target page sorted by page */
+  unsigned int by_page_length; /**< Number of entries in by_page */
+  outline_key_t* by_title; /**< Entries sorted by their folded title */
+};
+
+/**
+ * Page labels of a document
+ */
+struct pdf_page_labels_s {
+  char** labels; /**< Label of every page or NULL */
+  outline_key_t* by_label; /**< Pages with a label sorted by label */
+  unsigned int by_label_length; /**< Number of entries in by_label */
+};
+
+static char* fold_title(const char* title);
+static int compare_pages(const void* a, const void* b);
+static int compare_keys(const void* a, const void* b);
+static unsigned int lower_bound(const outline_key_t* keys, unsigned int
+    length, const char* key);
+static pdf_page_labels_t* page_labels_new(PopplerDocument* poppler_document,
+    unsigned int number_of_pages);
+static pdf_outline_entry_t* entry_new(const pdf_outline_item_t* item);
+
+pdf_outline_t*
+pdf_outline_new(GArray* items)
+{
+  pdf_outline_t* outline = g_malloc0(sizeof(pdf_outline_t));
+  outline->items         = items;
+  outline->by_page       = g_malloc(sizeof(outline_page_t) * MAX(items->len, 1));
+  outline->by_title      = g_malloc(sizeof(outline_key_t) * MAX(items->len, 1));
+
+  for (unsigned int i = 0; i < items->len; i++) {
+    const pdf_outline_item_t* item = &g_array_index(items, pdf_outline_item_t, i);
+
+    if (item->page != G_MAXUINT) {
+      outline->by_page[outline->by_page_length++] = (outline_page_t) { item->page, i };
+    }
+    outline->by_title[i] = (outline_key_t) { fold_title(item->title), i };
+  }
+
+  /* entries on the same page stay in document order, so the last one is the
+   * most specific */
+  qsort(outline->by_page, outline->by_page_length, sizeof(outline_page_t), compare_pages);
+  qsort(outline->by_title, items->len, sizeof(outline_key_t), compare_keys);
+
+  return outline;
+}
+
+void
+pdf_outline_free(pdf_outline_t* outline)
+{
+  if (outline == NULL) {
+    return;
+  }
+
+  for (unsigned int i = 0; i < outline->items->len; i++) {
+    g_free(g_array_index(outline->items, pdf_outline_item_t, i).title);
+    g_free(outline->by_title[i].key);
+  }
+
+  g_array_free(outline->items, TRUE);
+  g_free(outline->by_page);
+  g_free(outline->by_title);
+  g_free(outline);
+}
+
+void
+pdf_page_labels_free(pdf_page_labels_t* page_labels, unsigned int number_of_pages)
+{
+  if (page_labels == NULL) {
+    return;
+  }
+
+  for (unsigned int i = 0; i < number_of_pages; i++) {
+    g_free(page_labels->labels[i]);
+  }
+
+  g_free(page_labels->labels);
+  g_free(page_labels->by_label);
+  g_free(page_labels);
+}
+
+pdf_outline_entry_t*
+pdf_document_outline_find_page(pdf_document_t* pdf_document, unsigned int page)
+{
+  if (pdf_document == NULL) {
+    return NULL;
+  }
+
+  pdf_outline_entry_t* entry = NULL;
+
+  pdf_document_lock(pdf_document);
+  g_mutex_lock(&pdf_document->outline_lock);
+  pdf_outline_t* outline = pdf_document_get_outline(pdf_document);
+
+  if (outline != NULL) {
+    /* find the last entry that starts on or before the page */
+    unsigned int low  = 0;
+    unsigned int high = outline->by_page_length;
+    while (low < high) {
+      const unsigned int middle = low + (high - low) / 2;
+      if (outline->by_page[middle].page <= page) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+
+    if (low > 0) {
+      entry = entry_new(&g_array_index(outline->items, pdf_outline_item_t,
+            outline->by_page[low - 1].position));
+    }
+  }
+  g_mutex_unlock(&pdf_document->outline_lock);
+  pdf_document_unlock(pdf_document);
+
+  return entry;
+}
+
+GList*
+pdf_document_outline_find_title(pdf_document_t* pdf_document, const char* prefix)
+{
+  if (pdf_document == NULL || prefix == NULL) {
+    return NULL;
+  }
+
+  char* key           = fold_title(prefix);
+  const size_t length = strlen(key);
+  GList* entries      = NULL;
+
+  pdf_document_lock(pdf_document);
+  g_mutex_lock(&pdf_document->outline_lock);
+  pdf_outline_t* outline = pdf_document_get_outline(pdf_document);
+
+  if (outline != NULL) {
+    /* titles with the same prefix are next to each other */
+    for (unsigned int i = lower_bound(outline->by_title, outline->items->len, key);
+        i < outline->items->len && strncmp(outline->by_title[i].key, key, length) == 0; i++) {
+      entries = g_list_prepend(entries, entry_new(&g_array_index(outline->items,
+              pdf_outline_item_t, outline->by_title[i].position)));
+    }
+  }
+  g_mutex_unlock(&pdf_document->outline_lock);
+  pdf_document_unlock(pdf_document);
+
+  g_free(key);
+
+  return g_list_reverse(entries);
+}
+
+void
+pdf_outline_entry_free(pdf_outline_entry_t* entry)
+{
+  if (entry == NULL) {
+    return;
+  }
+
+  g_free(entry->title);
+  g_free(entry);
+}
+
+char*
+pdf_document_get_page_label(pdf_document_t* pdf_document, unsigned int index)
+{
+  if (pdf_document == NULL || index >= pdf_document->number_of_pages) {
+    return NULL;
+  }
+
+  pdf_document_lock(pdf_document);
+  g_mutex_lock(&pdf_document->outline_lock);
+  if (pdf_document->page_labels == NULL) {
+    pdf_document->page_labels = page_labels_new(pdf_document->poppler_document,
+        pdf_document->number_of_pages);
+  }
+  char* label = g_strdup(pdf_document->page_labels->labels[index]);
+  g_mutex_unlock(&pdf_document->outline_lock);
+  pdf_document_unlock(pdf_document);
+
+  return label;
+}
+
+bool
+pdf_document_find_page_label(pdf_document_t* pdf_document, const char* label,
+    unsigned int* index)
+{
+  if (pdf_document == NULL || label == NULL || index == NULL) {
+    return false;
+  }
+
+  pdf_document_lock(pdf_document);
+  g_mutex_lock(&pdf_document->outline_lock);
+  if (pdf_document->page_labels == NULL) {
+    pdf_document->page_labels = page_labels_new(pdf_document->poppler_document,
+        pdf_document->number_of_pages);
+  }
+
+  pdf_page_labels_t* page_labels = pdf_document->page_labels;
+  const unsigned int i = lower_bound(page_labels->by_label,
+      page_labels->by_label_length, label);
+  const bool found = i < page_labels->by_label_length &&
+    strcmp(page_labels->by_label[i].key, label) == 0;
+  if (found == true) {
+    *index = page_labels->by_label[i].position;
+  }
+  g_mutex_unlock(&pdf_document->outline_lock);
+  pdf_document_unlock(pdf_document);
+
+  return found;
+}
+
+static char*
+fold_title(const char* title)
+{
+  char* normalized = g_utf8_normalize(title != NULL ? title : "", -1, G_NORMALIZE_ALL);
+  if (normalized == NULL) {
+    return g_strdup("");
+  }
+
+  char* key = g_utf8_casefold(normalized, -1);
+  g_free(normalized);
+
+  return key;
+}
+
+static int
+compare_pages(const void* a, const void* b)
+{
+  const outline_page_t* page_a = a;
+  const outline_page_t* page_b = b;
+
+  if (page_a->page != page_b->page) {
+    return page_a->page < page_b->page ? -1 : 1;
+  }
+
+  return page_a->position < page_b->position ? -1 : (page_a->position > page_b->position);
+}
+
+static int
+compare_keys(const void* a, const void* b)
+{
+  const outline_key_t* key_a = a;
+  const outline_key_t* key_b = b;
+
+  const int result = strcmp(key_a->key, key_b->key);
+  if (result != 0) {
+    return result;
+  }
+
+  return key_a->position < key_b->position ? -1 : (key_a->position > key_b->position);
+}
+
+static unsigned int
+lower_bound(const outline_key_t* keys, unsigned int length, const char* key)
+{
+  unsigned int low  = 0;
+  unsigned int high = length;
+
+  while (low < high) {
+    const unsigned int middle = low + (high - low) / 2;
+    if (strcmp(keys[middle].key, key) < 0) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  return low;
+}
+
+static pdf_page_labels_t*
+page_labels_new(PopplerDocument* poppler_document, unsigned int number_of_pages)
+{
+  pdf_page_labels_t* page_labels = g_malloc0(sizeof(pdf_page_labels_t));
+  page_labels->labels   = g_malloc0(sizeof(char*) * MAX(number_of_pages, 1));
+  page_labels->by_label = g_malloc(sizeof(outline_key_t) * MAX(number_of_pages, 1));
+
+  for (unsigned int i = 0; i < number_of_pages; i++) {
+    PopplerPage* poppler_page = poppler_document_get_page(poppler_document, i);
+    if (poppler_page == NULL) {
+      continue;
+    }
+
+    page_labels->labels[i] = poppler_page_get_label(poppler_page);
+    g_object_unref(poppler_page);
+
+    if (page_labels->labels[i] != NULL) {
+      page_labels->by_label[page_labels->by_label_length++] =
+        (outline_key_t) { page_labels->labels[i], i };
+    }
+  }
+
+  /* the first page wins if several pages share a label */
+  qsort(page_labels->by_label, page_labels->by_label_length,
+      sizeof(outline_key_t), compare_keys);
+
+  return page_labels;
+}
+
+static pdf_outline_entry_t*
+entry_new(const pdf_outline_item_t* item)
+{
+  pdf_outline_entry_t* entry = g_malloc0(sizeof(pdf_outline_entry_t));
+  entry->title = g_strdup(item->title);
+  entry->page  = item->page;
+  entry->depth = item->depth;
+
+  return entry;
+}
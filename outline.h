@@ -0,0 +1,52 @@
+/* See LICENSE file for license and copyright information */
+
+#ifndef OUTLINE_H
+#define OUTLINE_H
+
+#include "plugin.h"
+
+/**
+ * Outline entry as collected while walking the outline
+ */
+typedef struct pdf_outline_item_s {
+  char* title; /**< Title of the entry */
+  unsigned int page; /**< Index of the target page or G_MAXUINT if it has none */
+  unsigned int depth; /**< Depth of the entry, 0 for top level entries */
+} pdf_outline_item_t;
+
+/**
+ * Creates the lookup tables of an outline
+ *
+ * @param items Array of pdf_outline_item_t in document order, taken over by
+ *   the outline
+ * @return The outline
+ */
+pdf_outline_t* pdf_outline_new(GArray* items);
+
+/**
+ * Frees an outline
+ *
+ * @param outline The outline
+ */
+void pdf_outline_free(pdf_outline_t* outline);
+
+/**
+ * Frees the page labels of a document
+ *
+ * @param page_labels The page labels
+ * @param number_of_pages Number of pages of the document
+ */
+void pdf_page_labels_free(pdf_page_labels_t* page_labels, unsigned int
+    number_of_pages);
+
+/**
+ * Returns the outline of a document and walks the outline of the poppler
+ * document if the index has not been generated yet. Must be called with the
+ * outline lock held.
+ *
+ * @param pdf_document The document
+ * @return The outline or NULL if the document has none
+ */
+pdf_outline_t* pdf_document_get_outline(pdf_document_t* pdf_document);
+
+#endif // OUTLINE_H
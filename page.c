@@ -1,6 +1,23 @@
 /* See LICENSE file for license and copyright information */
 
 #include "plugin.h"
+#include "pagecache.h"
+#include "rendercache.h"
+
+/* Memory poppler needs for a loaded page without its text. Content streams
+ * are only parsed while a page is drawn, so this is the page object with its
+ * attributes. */
+#define PAGE_MEMORY_SIZE (4 * 1024)
+/* Memory poppler needs per character of an extracted text: the character in
+ * its word with font, position and edges, plus its share of the lines and
+ * blocks the words are arranged in */
+#define PAGE_TEXT_MEMORY_PER_CHARACTER 96
+/* Number of characters assumed for a text whose length is not known, about
+ * a page of dense prose */
+#define PAGE_TEXT_LENGTH_ESTIMATE 3000
+
+static size_t page_memory_size(pdf_page_t* pdf_page);
+static void page_trim(void* data);
 
 zathura_error_t
 pdf_page_init(zathura_page_t* page)
@@ -9,27 +26,45 @@ pdf_page_init(zathura_page_t* page)
     return ZATHURA_ERROR_INVALID_ARGUMENTS;
   }
 
-  zathura_document_t* document           = zathura_page_get_document(page);
-  PopplerDocument* poppler_document = zathura_document_get_data(document);
+  zathura_document_t* document = zathura_page_get_document(page);
+  pdf_document_t* pdf_document = zathura_document_get_data(document);
 
-  if (poppler_document == NULL) {
+  if (pdf_document == NULL) {
     return ZATHURA_ERROR_UNKNOWN;
   }
 
   /* init poppler data */
-  PopplerPage* poppler_page = poppler_document_get_page(poppler_document, zathura_page_get_index(page));
-
-  if (poppler_page == NULL) {
-    g_free(poppler_page);
-    return ZATHURA_ERROR_UNKNOWN;
-  }
-
-  zathura_page_set_data(page, poppler_page);
+  pdf_page_t* pdf_page = g_malloc0(sizeof(pdf_page_t));
+  pdf_page->document   = pdf_document;
+  pdf_page->index      = zathura_page_get_index(page);
+  g_mutex_init(&pdf_page->lock);
+  pdf_memory_entry_init(&pdf_page->memory, page_trim, pdf_page);
+  pdf_page_cache_init(pdf_page);
 
   /* calculate dimensions */
   double width;
   double height;
-  poppler_page_get_size(poppler_page, &width, &height);
+  if (pdf_document->page_sizes != NULL) {
+    /* the page is loaded on first use */
+    g_mutex_lock(&pdf_document->page_sizes_lock);
+    width  = pdf_document->page_sizes[2 * pdf_page->index];
+    height = pdf_document->page_sizes[2 * pdf_page->index + 1];
+    g_mutex_unlock(&pdf_document->page_sizes_lock);
+  } else {
+    pdf_page->poppler_page = poppler_document_get_page(pdf_document->poppler_document,
+        pdf_page->index);
+
+    if (pdf_page->poppler_page == NULL) {
+      g_mutex_clear(&pdf_page->lock);
+      g_free(pdf_page);
+      return ZATHURA_ERROR_UNKNOWN;
+    }
+
+    poppler_page_get_size(pdf_page->poppler_page, &width, &height);
+    pdf_memory_touch(&pdf_page->memory, page_memory_size(pdf_page));
+  }
+
+  zathura_page_set_data(page, pdf_page);
   zathura_page_set_width(page, width);
   zathura_page_set_height(page, height);
 
@@ -37,15 +72,127 @@ pdf_page_init(zathura_page_t* page)
 }
 
 zathura_error_t
-pdf_page_clear(zathura_page_t* page, PopplerPage* poppler_page)
+pdf_page_clear(zathura_page_t* page, pdf_page_t* pdf_page)
 {
   if (page == NULL) {
     return ZATHURA_ERROR_INVALID_ARGUMENTS;
   }
 
-  if (poppler_page != NULL) {
-    g_object_unref(poppler_page);
+  if (pdf_page != NULL) {
+    pdf_memory_remove(&pdf_page->memory);
+    pdf_memory_remove(&pdf_page->cache_memory);
+    pdf_page_cache_clear(&pdf_page->cache);
+    if (pdf_page->poppler_page != NULL) {
+      g_object_unref(pdf_page->poppler_page);
+    }
+    g_mutex_clear(&pdf_page->lock);
+    g_free(pdf_page);
   }
 
   return ZATHURA_ERROR_OK;
 }
+
+PopplerPage*
+pdf_page_get_poppler_page(pdf_page_t* pdf_page)
+{
+  if (pdf_page == NULL) {
+    return NULL;
+  }
+
+  g_mutex_lock(&pdf_page->lock);
+
+  if (pdf_page->poppler_page == NULL) {
+    pdf_page->poppler_page = poppler_document_get_page(
+        pdf_page->document->poppler_document, pdf_page->index);
+  }
+
+  PopplerPage* poppler_page = NULL;
+  if (pdf_page->poppler_page != NULL) {
+    poppler_page = g_object_ref(pdf_page->poppler_page);
+  }
+  const size_t size = page_memory_size(pdf_page);
+
+  g_mutex_unlock(&pdf_page->lock);
+
+  /* the page lock is taken when the page is trimmed */
+  if (poppler_page != NULL) {
+    pdf_memory_touch(&pdf_page->memory, size);
+  }
+
+  return poppler_page;
+}
+
+void
+pdf_page_set_text_loaded(pdf_page_t* pdf_page, PopplerPage* poppler_page, int
+    text_length)
+{
+  if (pdf_page == NULL || poppler_page == NULL) {
+    return;
+  }
+
+  /* text of a page that has been trimmed meanwhile goes away with the last
+   * reference of the caller */
+  g_mutex_lock(&pdf_page->lock);
+  const bool accounted = pdf_page->text_loaded == true ||
+    pdf_page->poppler_page != poppler_page;
+  g_mutex_unlock(&pdf_page->lock);
+
+  if (accounted == true) {
+    return;
+  }
+
+  /* counting the characters would extract the text once more */
+  if (text_length < 0) {
+    text_length = PAGE_TEXT_LENGTH_ESTIMATE;
+  }
+
+  g_mutex_lock(&pdf_page->lock);
+  const bool loaded = pdf_page->poppler_page == poppler_page &&
+    pdf_page->text_loaded == false;
+  if (loaded == true) {
+    pdf_page->text_loaded = true;
+    pdf_page->text_length = text_length;
+  }
+  const size_t size = page_memory_size(pdf_page);
+  g_mutex_unlock(&pdf_page->lock);
+
+  if (loaded == true) {
+    pdf_memory_touch(&pdf_page->memory, size);
+  }
+}
+
+static size_t
+page_memory_size(pdf_page_t* pdf_page)
+{
+  if (pdf_page->poppler_page == NULL) {
+    return 0;
+  }
+
+  return PAGE_MEMORY_SIZE + (pdf_page->text_loaded == true ?
+      (size_t) pdf_page->text_length * PAGE_TEXT_MEMORY_PER_CHARACTER : 0);
+}
+
+static void
+page_trim(void* data)
+{
+  pdf_page_t* pdf_page = data;
+
+  /* users of the poppler page hold their own reference. Releasing the last
+   * one frees state of the poppler document, so it happens under its lock.
+   * Threads holding the document lock wait for running trims of the pages
+   * they use, so a page of a busy document is left loaded instead of waiting
+   * for the lock. It is accounted again on its next use. */
+  if (g_rec_mutex_trylock(&pdf_page->document->lock) == FALSE) {
+    return;
+  }
+
+  g_mutex_lock(&pdf_page->lock);
+  if (pdf_page->poppler_page != NULL) {
+    g_object_unref(pdf_page->poppler_page);
+    pdf_page->poppler_page = NULL;
+  }
+  pdf_page->text_loaded = false;
+  pdf_page->text_length = 0;
+  g_mutex_unlock(&pdf_page->lock);
+  pdf_document_unlock(pdf_page->document);
+}
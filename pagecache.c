@@ -0,0 +1,608 @@
+/* See LICENSE file for license and copyright information */
+
+#include <string.h>
+
+#include "pagecache.h"
+#include "rendercache.h"
+
+/* Rough estimate of the memory of a single link */
+#define LINK_MEMORY_ESTIMATE 256
+
+static bool load_text(pdf_page_cache_t* cache, PopplerPage* poppler_page);
+static size_t cache_memory_size(pdf_page_cache_t* cache);
+static void cache_trim(void* data);
+static bool matrix_equal(const cairo_matrix_t* a, const cairo_matrix_t* b);
+static bool content_matches(pdf_page_cache_t* cache, int width, int height,
+    const cairo_matrix_t* matrix, pdf_render_profile_t profile);
+static cairo_surface_t* compact_surface(cairo_surface_t* surface,
+    pdf_surface_encoding_t* encoding);
+static void paint_surface(cairo_t* cairo, cairo_surface_t* surface,
+    pdf_surface_encoding_t encoding);
+
+void
+pdf_page_cache_init(pdf_page_t* pdf_page)
+{
+  memset(&pdf_page->cache, 0, sizeof(pdf_page_cache_t));
+  pdf_memory_entry_init(&pdf_page->cache_memory, cache_trim, pdf_page);
+}
+
+void
+pdf_page_cache_clear(pdf_page_cache_t* cache)
+{
+  g_free(cache->text);
+  g_free(cache->text_layout);
+  if (cache->link_mapping != NULL) {
+    poppler_page_free_link_mapping(cache->link_mapping);
+  }
+  if (cache->surface != NULL) {
+    cairo_surface_destroy(cache->surface);
+  }
+  if (cache->content != NULL) {
+    cairo_surface_destroy(cache->content);
+  }
+  if (cache->annotations != NULL) {
+    cairo_surface_destroy(cache->annotations);
+  }
+  if (cache->recording != NULL) {
+    cairo_surface_destroy(cache->recording);
+  }
+
+  memset(cache, 0, sizeof(pdf_page_cache_t));
+}
+
+bool
+pdf_page_cache_get_text(pdf_page_t* pdf_page, PopplerPage* poppler_page,
+    char** text, PopplerRectangle** text_layout, guint* text_layout_length)
+{
+  pdf_page_cache_t* cache = &pdf_page->cache;
+
+  g_mutex_lock(&pdf_page->lock);
+
+  if (load_text(cache, poppler_page) == false) {
+    g_mutex_unlock(&pdf_page->lock);
+    return false;
+  }
+
+  *text                = g_strdup(cache->text);
+  *text_layout         = g_malloc(sizeof(PopplerRectangle) * cache->text_layout_length);
+  *text_layout_length  = cache->text_layout_length;
+  memcpy(*text_layout, cache->text_layout, sizeof(PopplerRectangle) *
+      cache->text_layout_length);
+
+  const int text_length = MIN(*text_layout_length, G_MAXINT);
+
+  g_mutex_unlock(&pdf_page->lock);
+
+  pdf_page_set_text_loaded(pdf_page, poppler_page, text_length);
+  pdf_page_cache_touch(pdf_page);
+
+  return true;
+}
+
+GList*
+pdf_page_cache_get_link_mapping(pdf_page_t* pdf_page, PopplerPage* poppler_page)
+{
+  pdf_page_cache_t* cache = &pdf_page->cache;
+
+  g_mutex_lock(&pdf_page->lock);
+
+  if (cache->link_mapping_loaded == false) {
+    cache->link_mapping        = poppler_page_get_link_mapping(poppler_page);
+    cache->link_mapping_loaded = true;
+  }
+
+  GList* link_mapping = NULL;
+  for (GList* link = cache->link_mapping; link != NULL; link = g_list_next(link)) {
+    link_mapping = g_list_prepend(link_mapping, poppler_link_mapping_copy(link->data));
+  }
+
+  g_mutex_unlock(&pdf_page->lock);
+
+  pdf_page_cache_touch(pdf_page);
+
+  return g_list_reverse(link_mapping);
+}
+
+bool
+pdf_page_cache_paint(pdf_page_t* pdf_page, cairo_t* cairo,
+    pdf_render_profile_t profile)
+{
+  cairo_surface_t* target = cairo_get_target(cairo);
+  if (cairo_surface_get_type(target) != CAIRO_SURFACE_TYPE_IMAGE) {
+    return false;
+  }
+
+  cairo_matrix_t matrix;
+  cairo_get_matrix(cairo, &matrix);
+
+  const int width  = cairo_image_surface_get_width(target);
+  const int height = cairo_image_surface_get_height(target);
+
+  pdf_page_cache_t* cache = &pdf_page->cache;
+  cairo_surface_t* surface = NULL;
+  pdf_surface_encoding_t encoding = PDF_SURFACE_COLOR;
+  cairo_surface_t* content     = NULL;
+  cairo_surface_t* annotations = NULL;
+
+  g_mutex_lock(&pdf_page->lock);
+  if (cache->surface != NULL && cache->surface_profile == profile &&
+      matrix_equal(&cache->surface_matrix, &matrix) == true &&
+      cairo_image_surface_get_width(cache->surface) == width &&
+      cairo_image_surface_get_height(cache->surface) == height) {
+    surface  = cairo_surface_reference(cache->surface);
+    encoding = cache->surface_encoding;
+  } else if (cache->annotations != NULL &&
+      content_matches(cache, width, height, &matrix, profile) == true) {
+    content     = cairo_surface_reference(cache->content);
+    annotations = cairo_surface_reference(cache->annotations);
+  }
+  g_mutex_unlock(&pdf_page->lock);
+
+  /* pages with annotations are kept as two layers */
+  if (content != NULL) {
+    pdf_page_cache_paint_layers(cairo, content, annotations);
+    cairo_surface_destroy(annotations);
+    cairo_surface_destroy(content);
+    pdf_page_cache_touch(pdf_page);
+    return true;
+  }
+
+  if (surface == NULL) {
+    /* the image may have been evicted into the compressed render cache */
+    surface = pdf_render_cache_load(pdf_page->document, pdf_page->index,
+        width, height, &matrix, profile, &encoding);
+    if (surface == NULL) {
+      return false;
+    }
+
+    g_mutex_lock(&pdf_page->lock);
+    if (cache->surface != NULL) {
+      cairo_surface_destroy(cache->surface);
+    }
+    cache->surface          = cairo_surface_reference(surface);
+    cache->surface_matrix   = matrix;
+    cache->surface_profile  = profile;
+    cache->surface_encoding = encoding;
+    g_mutex_unlock(&pdf_page->lock);
+  }
+
+  paint_surface(cairo, surface, encoding);
+
+  cairo_surface_destroy(surface);
+  pdf_page_cache_touch(pdf_page);
+
+  return true;
+}
+
+void
+pdf_page_cache_set_surface(pdf_page_t* pdf_page, cairo_surface_t* surface,
+    const cairo_matrix_t* matrix, pdf_render_profile_t profile)
+{
+  pdf_page_cache_t* cache = &pdf_page->cache;
+
+  pdf_surface_encoding_t encoding = PDF_SURFACE_COLOR;
+  cairo_surface_t* compact = compact_surface(surface, &encoding);
+
+  g_mutex_lock(&pdf_page->lock);
+  if (cache->surface != NULL) {
+    cairo_surface_destroy(cache->surface);
+  }
+  cache->surface          = compact;
+  cache->surface_matrix   = *matrix;
+  cache->surface_profile  = profile;
+  cache->surface_encoding = encoding;
+  g_mutex_unlock(&pdf_page->lock);
+
+  pdf_page_cache_touch(pdf_page);
+}
+
+cairo_surface_t*
+pdf_page_cache_get_content(pdf_page_t* pdf_page, int width, int height, const
+    cairo_matrix_t* matrix, pdf_render_profile_t profile)
+{
+  pdf_page_cache_t* cache  = &pdf_page->cache;
+  cairo_surface_t* content = NULL;
+
+  g_mutex_lock(&pdf_page->lock);
+  if (content_matches(cache, width, height, matrix, profile) == true) {
+    content = cairo_surface_reference(cache->content);
+  }
+  g_mutex_unlock(&pdf_page->lock);
+
+  if (content != NULL) {
+    pdf_page_cache_touch(pdf_page);
+  }
+
+  return content;
+}
+
+void
+pdf_page_cache_set_content(pdf_page_t* pdf_page, cairo_surface_t* surface,
+    const cairo_matrix_t* matrix, pdf_render_profile_t profile)
+{
+  pdf_page_cache_t* cache = &pdf_page->cache;
+
+  g_mutex_lock(&pdf_page->lock);
+  if (cache->content != NULL) {
+    cairo_surface_destroy(cache->content);
+  }
+  /* the annotation layer belongs to the previous content */
+  if (cache->annotations != NULL) {
+    cairo_surface_destroy(cache->annotations);
+    cache->annotations = NULL;
+  }
+  cache->content         = cairo_surface_reference(surface);
+  cache->content_matrix  = *matrix;
+  cache->content_profile = profile;
+  g_mutex_unlock(&pdf_page->lock);
+
+  pdf_page_cache_touch(pdf_page);
+}
+
+cairo_surface_t*
+pdf_page_cache_get_annotations(pdf_page_t* pdf_page, int width, int height,
+    const cairo_matrix_t* matrix, pdf_render_profile_t profile)
+{
+  pdf_page_cache_t* cache      = &pdf_page->cache;
+  cairo_surface_t* annotations = NULL;
+
+  g_mutex_lock(&pdf_page->lock);
+  if (cache->annotations != NULL &&
+      content_matches(cache, width, height, matrix, profile) == true) {
+    annotations = cairo_surface_reference(cache->annotations);
+  }
+  g_mutex_unlock(&pdf_page->lock);
+
+  return annotations;
+}
+
+void
+pdf_page_cache_set_annotations(pdf_page_t* pdf_page, cairo_surface_t*
+    surface, const cairo_matrix_t* matrix, pdf_render_profile_t profile)
+{
+  pdf_page_cache_t* cache = &pdf_page->cache;
+
+  /* the content may have been replaced or trimmed in the meantime */
+  g_mutex_lock(&pdf_page->lock);
+  const bool store = cache->content != NULL && cache->content_profile == profile &&
+    matrix_equal(&cache->content_matrix, matrix) == true;
+  if (store == true) {
+    if (cache->annotations != NULL) {
+      cairo_surface_destroy(cache->annotations);
+    }
+    cache->annotations = cairo_surface_reference(surface);
+  }
+  g_mutex_unlock(&pdf_page->lock);
+
+  if (store == true) {
+    pdf_page_cache_touch(pdf_page);
+  }
+}
+
+void
+pdf_page_cache_paint_layers(cairo_t* cairo, cairo_surface_t* content,
+    cairo_surface_t* annotations)
+{
+  double x = 0;
+  double y = 0;
+  cairo_surface_get_device_offset(annotations, &x, &y);
+  const int width  = cairo_image_surface_get_width(annotations);
+  const int height = cairo_image_surface_get_height(annotations);
+
+  cairo_save(cairo);
+  cairo_identity_matrix(cairo);
+
+  /* the content everywhere but in the area of the annotation layer ... */
+  cairo_rectangle(cairo, 0, 0, cairo_image_surface_get_width(content),
+      cairo_image_surface_get_height(content));
+  cairo_rectangle(cairo, -x, -y, width, height);
+  cairo_set_fill_rule(cairo, CAIRO_FILL_RULE_EVEN_ODD);
+  cairo_clip(cairo);
+  cairo_set_source_surface(cairo, content, 0, 0);
+  cairo_paint(cairo);
+  cairo_reset_clip(cairo);
+
+  /* ... and the annotation layer, which is placed by its device offset */
+  cairo_set_source_surface(cairo, annotations, 0, 0);
+  cairo_paint(cairo);
+
+  cairo_restore(cairo);
+}
+
+void
+pdf_page_cache_clear_annotations(pdf_page_t* pdf_page)
+{
+  pdf_page_cache_t* cache = &pdf_page->cache;
+
+  /* the content image is all that is left without annotations */
+  g_mutex_lock(&pdf_page->lock);
+  if (cache->surface != NULL) {
+    cairo_surface_destroy(cache->surface);
+    cache->surface = NULL;
+  }
+  if (cache->annotations != NULL) {
+    cairo_surface_destroy(cache->annotations);
+    cache->annotations = NULL;
+  }
+  if (cache->recording != NULL) {
+    cairo_surface_destroy(cache->recording);
+    cache->recording = NULL;
+  }
+  g_mutex_unlock(&pdf_page->lock);
+
+  pdf_page_cache_touch(pdf_page);
+}
+
+cairo_surface_t*
+pdf_page_cache_get_recording(pdf_page_t* pdf_page, double scale,
+    pdf_render_profile_t profile)
+{
+  pdf_page_cache_t* cache    = &pdf_page->cache;
+  cairo_surface_t* recording = NULL;
+
+  g_mutex_lock(&pdf_page->lock);
+  if (cache->recording != NULL && cache->recording_profile == profile &&
+      cache->recording_scale == scale) {
+    recording = cairo_surface_reference(cache->recording);
+  }
+  g_mutex_unlock(&pdf_page->lock);
+
+  if (recording != NULL) {
+    pdf_page_cache_touch(pdf_page);
+  }
+
+  return recording;
+}
+
+void
+pdf_page_cache_set_recording(pdf_page_t* pdf_page, cairo_surface_t* recording,
+    double scale, pdf_render_profile_t profile, size_t size)
+{
+  pdf_page_cache_t* cache = &pdf_page->cache;
+
+  g_mutex_lock(&pdf_page->lock);
+  if (cache->recording != NULL) {
+    cairo_surface_destroy(cache->recording);
+  }
+  cache->recording         = cairo_surface_reference(recording);
+  cache->recording_scale   = scale;
+  cache->recording_profile = profile;
+  cache->recording_size    = size;
+  g_mutex_unlock(&pdf_page->lock);
+
+  pdf_page_cache_touch(pdf_page);
+}
+
+void
+pdf_page_cache_touch(pdf_page_t* pdf_page)
+{
+  g_mutex_lock(&pdf_page->lock);
+  const size_t size = cache_memory_size(&pdf_page->cache);
+  g_mutex_unlock(&pdf_page->lock);
+
+  if (size > 0) {
+    pdf_memory_touch(&pdf_page->cache_memory, size);
+  } else {
+    pdf_memory_remove(&pdf_page->cache_memory);
+  }
+}
+
+static bool
+load_text(pdf_page_cache_t* cache, PopplerPage* poppler_page)
+{
+  if (cache->text != NULL) {
+    return true;
+  }
+
+  /* the text layout contains one rectangle per character of the page text */
+  char* text = poppler_page_get_text(poppler_page);
+  PopplerRectangle* text_layout = NULL;
+  guint text_layout_length      = 0;
+
+  if (text == NULL || poppler_page_get_text_layout(poppler_page, &text_layout,
+        &text_layout_length) == FALSE) {
+    g_free(text);
+    g_free(text_layout);
+    return false;
+  }
+
+  cache->text               = text;
+  cache->text_layout        = text_layout;
+  cache->text_layout_length = text_layout_length;
+
+  return true;
+}
+
+static size_t
+cache_memory_size(pdf_page_cache_t* cache)
+{
+  size_t size = 0;
+
+  if (cache->text != NULL) {
+    size += strlen(cache->text) + sizeof(PopplerRectangle) * cache->text_layout_length;
+  }
+
+  if (cache->link_mapping != NULL) {
+    size += LINK_MEMORY_ESTIMATE * g_list_length(cache->link_mapping);
+  }
+
+  if (cache->surface != NULL) {
+    size += (size_t) cairo_image_surface_get_stride(cache->surface) *
+      cairo_image_surface_get_height(cache->surface);
+  }
+
+  if (cache->content != NULL) {
+    size += (size_t) cairo_image_surface_get_stride(cache->content) *
+      cairo_image_surface_get_height(cache->content);
+  }
+
+  if (cache->annotations != NULL) {
+    size += (size_t) cairo_image_surface_get_stride(cache->annotations) *
+      cairo_image_surface_get_height(cache->annotations);
+  }
+
+  if (cache->recording != NULL) {
+    size += cache->recording_size;
+  }
+
+  return size;
+}
+
+static void
+cache_trim(void* data)
+{
+  pdf_page_t* pdf_page    = data;
+  pdf_page_cache_t* cache = &pdf_page->cache;
+
+  /* the image moves to the render cache once the page lock is released */
+  g_mutex_lock(&pdf_page->lock);
+  cairo_surface_t* surface = cache->surface != NULL ?
+    cairo_surface_reference(cache->surface) : NULL;
+  const cairo_matrix_t matrix           = cache->surface_matrix;
+  const pdf_render_profile_t profile    = cache->surface_profile;
+  const pdf_surface_encoding_t encoding = cache->surface_encoding;
+  pdf_page_cache_clear(cache);
+  g_mutex_unlock(&pdf_page->lock);
+
+  if (surface != NULL) {
+    pdf_render_cache_store(pdf_page->document, pdf_page->index, surface,
+        &matrix, profile, encoding);
+    cairo_surface_destroy(surface);
+  }
+}
+
+static bool
+matrix_equal(const cairo_matrix_t* a, const cairo_matrix_t* b)
+{
+  return a->xx == b->xx && a->yx == b->yx && a->xy == b->xy &&
+    a->yy == b->yy && a->x0 == b->x0 && a->y0 == b->y0;
+}
+
+static bool
+content_matches(pdf_page_cache_t* cache, int width, int height, const
+    cairo_matrix_t* matrix, pdf_render_profile_t profile)
+{
+  return cache->content != NULL && cache->content_profile == profile &&
+    matrix_equal(&cache->content_matrix, matrix) == true &&
+    cairo_image_surface_get_width(cache->content) == width &&
+    cairo_image_surface_get_height(cache->content) == height;
+}
+
+static cairo_surface_t*
+compact_surface(cairo_surface_t* surface, pdf_surface_encoding_t* encoding)
+{
+  *encoding = PDF_SURFACE_COLOR;
+  if (cairo_image_surface_get_format(surface) != CAIRO_FORMAT_ARGB32) {
+    return cairo_surface_reference(surface);
+  }
+
+  cairo_surface_flush(surface);
+
+  const int width            = cairo_image_surface_get_width(surface);
+  const int height           = cairo_image_surface_get_height(surface);
+  const int stride           = cairo_image_surface_get_stride(surface);
+  const unsigned char* data  = cairo_image_surface_get_data(surface);
+
+  /* black ink with any coverage is stored as its alpha, an opaque gray page
+   * as its luminance; both are exact */
+  bool ink          = true;
+  bool ink_bilevel  = true;
+  bool gray         = true;
+  bool gray_bilevel = true;
+
+  for (int y = 0; y < height && (ink == true || gray == true); y++) {
+    const guint32* row = (const guint32*) (data + (size_t) y * stride);
+    for (int x = 0; x < width; x++) {
+      const guint32 alpha = row[x] >> 24;
+      const guint32 red   = (row[x] >> 16) & 0xff;
+      const guint32 green = (row[x] >> 8) & 0xff;
+      const guint32 blue  = row[x] & 0xff;
+
+      if (red != green || green != blue) {
+        ink  = false;
+        gray = false;
+        break;
+      }
+
+      ink  = ink == true && red == 0;
+      gray = gray == true && alpha == 0xff;
+
+      if (alpha != 0 && alpha != 0xff) {
+        ink_bilevel = false;
+      }
+      if (red != 0 && red != 0xff) {
+        gray_bilevel = false;
+      }
+    }
+  }
+
+  if (ink == false && gray == false) {
+    return cairo_surface_reference(surface);
+  }
+
+  const bool bilevel = ink == true ? ink_bilevel : gray_bilevel;
+  cairo_surface_t* compact = cairo_image_surface_create(bilevel == true ?
+      CAIRO_FORMAT_A1 : CAIRO_FORMAT_A8, width, height);
+  if (cairo_surface_status(compact) != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy(compact);
+    return cairo_surface_reference(surface);
+  }
+
+  cairo_surface_flush(compact);
+  unsigned char* compact_data = cairo_image_surface_get_data(compact);
+  const int compact_stride    = cairo_image_surface_get_stride(compact);
+
+  for (int y = 0; y < height; y++) {
+    const guint32* row   = (const guint32*) (data + (size_t) y * stride);
+    unsigned char* value = compact_data + (size_t) y * compact_stride;
+
+    for (int x = 0; x < width; x++) {
+      const guint32 v = ink == true ? row[x] >> 24 : row[x] & 0xff;
+
+      if (bilevel == false) {
+        value[x] = v;
+      } else if (v != 0) {
+        /* A1 pixels are packed into 32 bit words in native bit order */
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+        ((guint32*) value)[x >> 5] |= 1u << (x & 31);
+#else
+        ((guint32*) value)[x >> 5] |= 1u << (31 - (x & 31));
+#endif
+      }
+    }
+  }
+
+  cairo_surface_mark_dirty(compact);
+  *encoding = ink == true ? PDF_SURFACE_INK : PDF_SURFACE_GRAY;
+
+  return compact;
+}
+
+static void
+paint_surface(cairo_t* cairo, cairo_surface_t* surface, pdf_surface_encoding_t
+    encoding)
+{
+  cairo_save(cairo);
+  cairo_identity_matrix(cairo);
+
+  switch (encoding) {
+    case PDF_SURFACE_INK:
+      cairo_set_source_rgb(cairo, 0, 0, 0);
+      cairo_mask_surface(cairo, surface, 0, 0);
+      break;
+    case PDF_SURFACE_GRAY:
+      cairo_rectangle(cairo, 0, 0, cairo_image_surface_get_width(surface),
+          cairo_image_surface_get_height(surface));
+      cairo_set_source_rgb(cairo, 0, 0, 0);
+      cairo_fill(cairo);
+      cairo_set_source_rgb(cairo, 1, 1, 1);
+      cairo_mask_surface(cairo, surface, 0, 0);
+      break;
+    default:
+      cairo_set_source_surface(cairo, surface, 0, 0);
+      cairo_paint(cairo);
+      break;
+  }
+
+  cairo_restore(cairo);
+}
@@ -0,0 +1,179 @@
+/* See LICENSE file for license and copyright information */
+
+#ifndef PAGECACHE_H
+#define PAGECACHE_H
+
+#include "plugin.h"
+
+/**
+ * Initializes the cache of a page
+ *
+ * @param pdf_page The page
+ */
+void pdf_page_cache_init(pdf_page_t* pdf_page);
+
+/**
+ * Frees everything held by a page cache
+ *
+ * @param cache The cache
+ */
+void pdf_page_cache_clear(pdf_page_cache_t* cache);
+
+/**
+ * Returns the text of a page together with the rectangle of every character
+ *
+ * @param pdf_page The page
+ * @param poppler_page The poppler page
+ * @param text Set to the text (needs to be deallocated with g_free)
+ * @param text_layout Set to the rectangles (needs to be deallocated with
+ *   g_free)
+ * @param text_layout_length Set to the number of rectangles
+ * @return true if the text is available
+ */
+bool pdf_page_cache_get_text(pdf_page_t* pdf_page, PopplerPage* poppler_page,
+    char** text, PopplerRectangle** text_layout, guint* text_layout_length);
+
+/**
+ * Returns the link mapping of a page
+ *
+ * @param pdf_page The page
+ * @param poppler_page The poppler page
+ * @return Copy of the link mapping (needs to be deallocated with
+ *   poppler_page_free_link_mapping)
+ */
+GList* pdf_page_cache_get_link_mapping(pdf_page_t* pdf_page, PopplerPage*
+    poppler_page);
+
+/**
+ * Paints the cached image of a page if it has been rendered for the same
+ * target size, transformation and profile before
+ *
+ * @param pdf_page The page
+ * @param cairo Cairo object
+ * @param profile The render profile
+ * @return true if the cached image has been painted
+ */
+bool pdf_page_cache_paint(pdf_page_t* pdf_page, cairo_t* cairo,
+    pdf_render_profile_t profile);
+
+/**
+ * Stores the rendered image of a page. Images of grayscale or black and white
+ * pages are kept in A8 or A1 format and expanded when they are painted.
+ *
+ * @param pdf_page The page
+ * @param surface Image surface of the size of the render target
+ * @param matrix Transformation the image was rendered with
+ * @param profile The render profile
+ */
+void pdf_page_cache_set_surface(pdf_page_t* pdf_page, cairo_surface_t*
+    surface, const cairo_matrix_t* matrix, pdf_render_profile_t profile);
+
+/**
+ * Returns the rendered image of a page without annotations
+ *
+ * @param pdf_page The page
+ * @param width Width of the render target
+ * @param height Height of the render target
+ * @param matrix Transformation of the render target
+ * @param profile The render profile
+ * @return Reference to the image (needs to be released with
+ *   cairo_surface_destroy) or NULL if it has not been rendered for this
+ *   target and profile
+ */
+cairo_surface_t* pdf_page_cache_get_content(pdf_page_t* pdf_page, int width,
+    int height, const cairo_matrix_t* matrix, pdf_render_profile_t profile);
+
+/**
+ * Stores the rendered image of a page without annotations
+ *
+ * @param pdf_page The page
+ * @param surface ARGB32 image of the size of the render target
+ * @param matrix Transformation the image was rendered with
+ * @param profile The render profile
+ */
+void pdf_page_cache_set_content(pdf_page_t* pdf_page, cairo_surface_t*
+    surface, const cairo_matrix_t* matrix, pdf_render_profile_t profile);
+
+/**
+ * Returns the annotation layer of a page that belongs to its cached content
+ *
+ * @param pdf_page The page
+ * @param width Width of the render target
+ * @param height Height of the render target
+ * @param matrix Transformation of the render target
+ * @param profile The render profile
+ * @return Reference to the layer (needs to be released with
+ *   cairo_surface_destroy) or NULL if there is none for this target and
+ *   profile
+ */
+cairo_surface_t* pdf_page_cache_get_annotations(pdf_page_t* pdf_page, int
+    width, int height, const cairo_matrix_t* matrix, pdf_render_profile_t
+    profile);
+
+/**
+ * Stores the annotation layer of a page. It is dropped together with the
+ * content it belongs to.
+ *
+ * @param pdf_page The page
+ * @param surface ARGB32 image of the area covered by the annotations, with a
+ *   device offset placing it in the render target (see
+ *   pdf_page_cache_paint_layers)
+ * @param matrix Transformation the content was rendered with
+ * @param profile The render profile
+ */
+void pdf_page_cache_set_annotations(pdf_page_t* pdf_page, cairo_surface_t*
+    surface, const cairo_matrix_t* matrix, pdf_render_profile_t profile);
+
+/**
+ * Paints the content of a page and the annotation layer on top of it. The
+ * annotation layer replaces the content in its area, which holds both the
+ * content and the annotations.
+ *
+ * @param cairo Cairo object of the render target
+ * @param content Image of the page without annotations
+ * @param annotations Image of the area covered by the annotations
+ */
+void pdf_page_cache_paint_layers(cairo_t* cairo, cairo_surface_t* content,
+    cairo_surface_t* annotations);
+
+/**
+ * Drops everything from the cache of a page that contains its annotations
+ *
+ * @param pdf_page The page
+ */
+void pdf_page_cache_clear_annotations(pdf_page_t* pdf_page);
+
+/**
+ * Returns the recorded drawing operations of a page
+ *
+ * @param pdf_page The page
+ * @param scale Scale the page has been recorded at
+ * @param profile The render profile
+ * @return Reference to the recording surface (needs to be released with
+ *   cairo_surface_destroy) or NULL if the page has not been recorded at this
+ *   scale and with this profile
+ */
+cairo_surface_t* pdf_page_cache_get_recording(pdf_page_t* pdf_page, double
+    scale, pdf_render_profile_t profile);
+
+/**
+ * Stores the recorded drawing operations of a page
+ *
+ * @param pdf_page The page
+ * @param recording Recording surface in page space multiplied by scale
+ * @param scale Scale the page was recorded at
+ * @param profile The render profile
+ * @param size Estimated memory of the recording in bytes
+ */
+void pdf_page_cache_set_recording(pdf_page_t* pdf_page, cairo_surface_t*
+    recording, double scale, pdf_render_profile_t profile, size_t size);
+
+/**
+ * Updates the memory accounted for the cache of a page. Must be called
+ * without holding the page lock.
+ *
+ * @param pdf_page The page
+ */
+void pdf_page_cache_touch(pdf_page_t* pdf_page);
+
+#endif // PAGECACHE_H
@@ -2,25 +2,186 @@
 
 #include "plugin.h"
 
+/* Hosts may call the functions of a document from several threads, e.g.
+ * render pages on worker threads while searching on the main thread. Poppler
+ * documents are not safe for concurrent use, so every function that uses the
+ * poppler document holds the lock of the document. Renders acquire a document
+ * of their own instead (see pdf_document_acquire_render_document). */
+
+static zathura_error_t
+document_free(zathura_document_t* document, pdf_document_t* pdf_document)
+{
+  /* pdf_document_free waits for the functions that are still using the
+   * document, but no lock can keep a thread from using it after it has been
+   * freed. zathura only frees a document after it stopped its render thread,
+   * and calls all other functions from the main thread that frees it, so no
+   * function of the document is called after this. */
+  return pdf_document_free(document, pdf_document);
+}
+
+static zathura_error_t
+document_save_as(zathura_document_t* document, pdf_document_t* pdf_document,
+    const char* path)
+{
+  pdf_document_lock(pdf_document);
+  zathura_error_t error = pdf_document_save_as(document, pdf_document, path);
+  pdf_document_unlock(pdf_document);
+
+  return error;
+}
+
+static girara_tree_node_t*
+document_index_generate(zathura_document_t* document, pdf_document_t*
+    pdf_document, zathura_error_t* error)
+{
+  pdf_document_lock(pdf_document);
+  girara_tree_node_t* root = pdf_document_index_generate(document, pdf_document, error);
+  pdf_document_unlock(pdf_document);
+
+  return root;
+}
+
+static girara_list_t*
+document_attachments_get(zathura_document_t* document, pdf_document_t*
+    pdf_document, zathura_error_t* error)
+{
+  pdf_document_lock(pdf_document);
+  girara_list_t* list = pdf_document_attachments_get(document, pdf_document, error);
+  pdf_document_unlock(pdf_document);
+
+  return list;
+}
+
+static zathura_error_t
+document_attachment_save(zathura_document_t* document, pdf_document_t*
+    pdf_document, const char* attachment, const char* filename)
+{
+  pdf_document_lock(pdf_document);
+  zathura_error_t error = pdf_document_attachment_save(document, pdf_document,
+      attachment, filename);
+  pdf_document_unlock(pdf_document);
+
+  return error;
+}
+
+static girara_list_t*
+document_get_information(zathura_document_t* document, pdf_document_t*
+    pdf_document, zathura_error_t* error)
+{
+  pdf_document_lock(pdf_document);
+  girara_list_t* list = pdf_document_get_information(document, pdf_document, error);
+  pdf_document_unlock(pdf_document);
+
+  return list;
+}
+
+static zathura_error_t
+page_init(zathura_page_t* page)
+{
+  pdf_document_t* pdf_document = page != NULL ?
+    zathura_document_get_data(zathura_page_get_document(page)) : NULL;
+
+  pdf_document_lock(pdf_document);
+  zathura_error_t error = pdf_page_init(page);
+  pdf_document_unlock(pdf_document);
+
+  return error;
+}
+
+static zathura_error_t
+page_clear(zathura_page_t* page, pdf_page_t* pdf_page)
+{
+  pdf_document_t* pdf_document = pdf_page != NULL ? pdf_page->document : NULL;
+
+  pdf_document_lock(pdf_document);
+  zathura_error_t error = pdf_page_clear(page, pdf_page);
+  pdf_document_unlock(pdf_document);
+
+  return error;
+}
+
+static girara_list_t*
+page_search_text(zathura_page_t* page, pdf_page_t* pdf_page, const char* text,
+    zathura_error_t* error)
+{
+  pdf_document_t* pdf_document = pdf_page != NULL ? pdf_page->document : NULL;
+
+  pdf_document_lock(pdf_document);
+  girara_list_t* list = pdf_page_search_text(page, pdf_page, text, error);
+  pdf_document_unlock(pdf_document);
+
+  return list;
+}
+
+static girara_list_t*
+page_links_get(zathura_page_t* page, pdf_page_t* pdf_page, zathura_error_t* error)
+{
+  pdf_document_t* pdf_document = pdf_page != NULL ? pdf_page->document : NULL;
+
+  pdf_document_lock(pdf_document);
+  girara_list_t* list = pdf_page_links_get(page, pdf_page, error);
+  pdf_document_unlock(pdf_document);
+
+  return list;
+}
+
+static girara_list_t*
+page_images_get(zathura_page_t* page, pdf_page_t* pdf_page, zathura_error_t* error)
+{
+  pdf_document_t* pdf_document = pdf_page != NULL ? pdf_page->document : NULL;
+
+  pdf_document_lock(pdf_document);
+  girara_list_t* list = pdf_page_images_get(page, pdf_page, error);
+  pdf_document_unlock(pdf_document);
+
+  return list;
+}
+
+static char*
+page_get_text(zathura_page_t* page, pdf_page_t* pdf_page, zathura_rectangle_t
+    rectangle, zathura_error_t* error)
+{
+  pdf_document_t* pdf_document = pdf_page != NULL ? pdf_page->document : NULL;
+
+  pdf_document_lock(pdf_document);
+  char* text = pdf_page_get_text(page, pdf_page, rectangle, error);
+  pdf_document_unlock(pdf_document);
+
+  return text;
+}
+
+static cairo_surface_t*
+page_image_get_cairo(zathura_page_t* page, pdf_page_t* pdf_page,
+    zathura_image_t* image, zathura_error_t* error)
+{
+  pdf_document_t* pdf_document = pdf_page != NULL ? pdf_page->document : NULL;
+
+  pdf_document_lock(pdf_document);
+  cairo_surface_t* surface = pdf_page_image_get_cairo(page, pdf_page, image, error);
+  pdf_document_unlock(pdf_document);
+
+  return surface;
+}
+
 void
 register_functions(zathura_plugin_functions_t* functions)
 {
   functions->document_open            = (zathura_plugin_document_open_t) pdf_document_open;
-  functions->document_free            = (zathura_plugin_document_free_t) pdf_document_free;
-  functions->document_index_generate  = (zathura_plugin_document_index_generate_t) pdf_document_index_generate;
-  functions->document_save_as         = (zathura_plugin_document_save_as_t) pdf_document_save_as;
-  functions->document_attachments_get = (zathura_plugin_document_attachments_get_t) pdf_document_attachments_get;
-  functions->document_attachment_save = (zathura_plugin_document_attachment_save_t) pdf_document_attachment_save;
-  functions->document_get_information = (zathura_plugin_document_get_information_t) pdf_document_get_information;
-  functions->page_init                = (zathura_plugin_page_init_t) pdf_page_init;
-  functions->page_clear               = (zathura_plugin_page_clear_t) pdf_page_clear;
-  functions->page_search_text         = (zathura_plugin_page_search_text_t) pdf_page_search_text;
-  functions->page_links_get           = (zathura_plugin_page_links_get_t) pdf_page_links_get;
+  functions->document_free            = (zathura_plugin_document_free_t) document_free;
+  functions->document_index_generate  = (zathura_plugin_document_index_generate_t) document_index_generate;
+  functions->document_save_as         = (zathura_plugin_document_save_as_t) document_save_as;
+  functions->document_attachments_get = (zathura_plugin_document_attachments_get_t) document_attachments_get;
+  functions->document_attachment_save = (zathura_plugin_document_attachment_save_t) document_attachment_save;
+  functions->document_get_information = (zathura_plugin_document_get_information_t) document_get_information;
+  functions->page_init                = (zathura_plugin_page_init_t) page_init;
+  functions->page_clear               = (zathura_plugin_page_clear_t) page_clear;
+  functions->page_search_text         = (zathura_plugin_page_search_text_t) page_search_text;
+  functions->page_links_get           = (zathura_plugin_page_links_get_t) page_links_get;
   functions->page_form_fields_get     = (zathura_plugin_page_form_fields_get_t) pdf_page_form_fields_get;
-  functions->page_images_get          = (zathura_plugin_page_images_get_t) pdf_page_images_get;
-  functions->page_get_text            = (zathura_plugin_page_get_text_t) pdf_page_get_text;
+  functions->page_images_get          = (zathura_plugin_page_images_get_t) page_images_get;
+  functions->page_get_text            = (zathura_plugin_page_get_text_t) page_get_text;
   functions->page_render_cairo        = (zathura_plugin_page_render_cairo_t) pdf_page_render_cairo;
-  functions->page_image_get_cairo     = (zathura_plugin_page_image_get_cairo_t) pdf_page_image_get_cairo;
+  functions->page_image_get_cairo     = (zathura_plugin_page_image_get_cairo_t) page_image_get_cairo;
 }
 
 ZATHURA_PLUGIN_REGISTER(
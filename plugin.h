@@ -12,6 +12,137 @@
 #include <zathura/document.h>
 #include <zathura/plugin-api.h>
 
+#include "memory.h"
+
+/**
+ * Render profiles
+ */
+typedef enum pdf_render_profile_e {
+  PDF_RENDER_PROFILE_FINAL, /**< Full quality */
+  PDF_RENDER_PROFILE_INTERACTIVE /**< Fast rendering while scrolling */
+} pdf_render_profile_t;
+
+/**
+ * How the cached image of a page is stored
+ */
+typedef enum pdf_surface_encoding_e {
+  PDF_SURFACE_COLOR, /**< ARGB32 image */
+  PDF_SURFACE_INK, /**< A8 or A1 coverage of black ink */
+  PDF_SURFACE_GRAY /**< A8 or A1 luminance of an opaque page */
+} pdf_surface_encoding_t;
+
+/**
+ * State of a page that is cached by the plugin
+ */
+typedef struct pdf_page_cache_s {
+  char* text; /**< Text of the page or NULL if it has not been extracted yet */
+  PopplerRectangle* text_layout; /**< Rectangle of every character of text */
+  guint text_layout_length; /**< Number of rectangles in text_layout */
+  GList* link_mapping; /**< Link mapping of the page */
+  bool link_mapping_loaded; /**< Set if link_mapping has been loaded */
+  cairo_surface_t* surface; /**< Last rendered image of the page or NULL */
+  cairo_matrix_t surface_matrix; /**< Transformation surface was rendered with */
+  pdf_render_profile_t surface_profile; /**< Profile surface was rendered with */
+  pdf_surface_encoding_t surface_encoding; /**< How surface is stored */
+  cairo_surface_t* content; /**< Rendered image of the page without annotations or NULL */
+  cairo_matrix_t content_matrix; /**< Transformation content was rendered with */
+  pdf_render_profile_t content_profile; /**< Profile content was rendered with */
+  cairo_surface_t* annotations; /**< Part of the page covered by annotations, rendered over content, or NULL */
+  cairo_surface_t* recording; /**< Recorded drawing operations of the page or NULL */
+  double recording_scale; /**< Scale recording was made at */
+  pdf_render_profile_t recording_profile; /**< Profile recording was made with */
+  size_t recording_size; /**< Estimated memory of recording in bytes */
+} pdf_page_cache_t;
+
+/**
+ * Lookup tables of the outline of a document (see outline.h)
+ */
+typedef struct pdf_outline_s pdf_outline_t;
+
+/**
+ * Lookup tables of the page labels of a document
+ */
+typedef struct pdf_page_labels_s pdf_page_labels_t;
+
+/**
+ * Render time statistics of a document (see profiler.h)
+ */
+typedef struct pdf_profiler_s pdf_profiler_t;
+
+/**
+ * Length of the permanent and update ID of a PDF file together
+ */
+#define PDF_DOCUMENT_ID_LENGTH 64
+
+/**
+ * Internal document structure
+ */
+typedef struct pdf_document_s {
+  zathura_document_t* document; /**< Zathura document */
+  PopplerDocument* poppler_document; /**< Poppler document */
+  unsigned int number_of_pages; /**< Number of pages */
+  guint8 id[PDF_DOCUMENT_ID_LENGTH]; /**< Permanent and update ID of the file */
+  bool id_known; /**< Set if the file has an ID */
+  gint64 file_mtime; /**< Modification time of the file in seconds */
+  gint64 file_size; /**< Size of the file in bytes */
+  bool file_known; /**< Set if file_mtime and file_size are known */
+  char* cache_key; /**< Key of the document in the cache or NULL */
+  char* render_cache_key; /**< Key of the document in the render cache or NULL */
+  GRecMutex lock; /**< Serializes the use of poppler_document */
+
+  GQueue render_copies; /**< Copies of poppler_document not used by any render */
+  unsigned int render_copies_open; /**< Number of copies opened for rendering */
+  bool render_copies_disabled; /**< Set once the document differs from the file */
+  GMutex render_copies_lock; /**< Lock for the render copies */
+  GCond render_copies_released; /**< Signalled when a copy is closed */
+
+  double* page_sizes; /**< Page sizes (width, height) known without loading the pages or NULL */
+  unsigned int page_sizes_loaded; /**< Number of entries in page_sizes that are final */
+  unsigned int page_sizes_applied; /**< Number of final sizes passed on to zathura */
+  GMutex page_sizes_lock; /**< Lock for page_sizes and page_sizes_loaded */
+
+  GThread* page_size_loader; /**< Thread loading the page sizes in the background */
+  gint page_size_loader_cancelled; /**< Set to stop the loader */
+  guint page_size_source; /**< Main loop source applying the loaded sizes */
+
+
+  pdf_render_profile_t render_profile; /**< Render profile set by the host */
+  gint64 render_profile_expiry; /**< Time at which render_profile falls back to final */
+  GMutex render_profile_lock; /**< Lock for render_profile and render_profile_expiry */
+  bool display_list_enabled; /**< Set if pages are replayed from recordings */
+  bool image_cache_enabled; /**< Set if rendered pages are kept */
+  pdf_profiler_t* profiler; /**< Render profiler or NULL if it is disabled */
+
+  pdf_outline_t* outline; /**< Outline lookup tables or NULL if not built yet */
+  pdf_page_labels_t* page_labels; /**< Page labels or NULL if not loaded yet */
+  GMutex outline_lock; /**< Lock for outline and page_labels */
+} pdf_document_t;
+
+/**
+ * Internal page structure
+ */
+typedef struct pdf_page_s {
+  pdf_document_t* document; /**< Document the page belongs to */
+  unsigned int index; /**< Page index */
+  PopplerPage* poppler_page; /**< Poppler page or NULL if it has not been loaded yet */
+  bool text_loaded; /**< Set if poppler holds the text of the page */
+  unsigned int text_length; /**< Number of characters of the text poppler holds */
+  bool annotations_edited; /**< Set once the annotations of the page have been changed */
+  pdf_page_cache_t cache; /**< Cached state of the page (see pagecache.h) */
+  GMutex lock; /**< Lock for poppler_page, text_loaded, annotations_edited and cache */
+  pdf_memory_entry_t memory; /**< Memory accounting of poppler_page */
+  pdf_memory_entry_t cache_memory; /**< Memory accounting of cache */
+} pdf_page_t;
+
+/**
+ * Called on the main context with the progress of an asynchronous operation
+ *
+ * @param done Units of work done so far, e.g. pages or outline entries
+ * @param total Total units of work or 0 if it is not known yet
+ * @param data Custom data
+ */
+typedef void (*pdf_progress_t)(unsigned int done, unsigned int total, void* data);
+
 /**
  * Open a pdf document
  *
@@ -22,13 +153,96 @@
 zathura_error_t pdf_document_open(zathura_document_t* document);
 
 /**
- * Closes and frees the internal document structure
+ * Opens a pdf document on a worker thread. The size of every page is loaded
+ * there as well and progress is reported per page. If the operation is
+ * cancelled, callback is invoked right away while the worker drops the
+ * document once poppler returns; poppler itself is not interrupted.
+ *
+ * zathura's plugin interface only calls pdf_document_open, so this and the
+ * other asynchronous functions are only used by hosts that call them
+ * directly.
+ *
+ * @param document Zathura document, needs to stay alive until callback has
+ *   been invoked
+ * @param cancellable Cancellable or NULL
+ * @param progress Progress callback or NULL
+ * @param progress_data Custom data passed to progress
+ * @param callback Callback invoked on the thread-default main context of the
+ *   calling thread, needs to call pdf_document_open_finish
+ * @param data Custom data passed to callback
+ */
+void pdf_document_open_async(zathura_document_t* document, GCancellable*
+    cancellable, pdf_progress_t progress, void* progress_data,
+    GAsyncReadyCallback callback, void* data);
+
+/**
+ * Finishes opening a pdf document and attaches it to the zathura document
+ *
+ * @param document Zathura document
+ * @param result The result passed to the callback
+ * @return ZATHURA_ERROR_OK when no error occurred, ZATHURA_ERROR_UNKNOWN if
+ *    the operation has been cancelled, otherwise see zathura_error_t
+ */
+zathura_error_t pdf_document_open_finish(zathura_document_t* document,
+    GAsyncResult* result);
+
+/**
+ * Closes and frees the internal document structure. Waits for renders and
+ * other functions that are still using the document. The caller has to make
+ * sure that no function of the document is called once this has been called.
  *
  * @param document Zathura document
  * @return ZATHURA_ERROR_OK when no error occurred, otherwise see
  *    zathura_error_t
  */
-zathura_error_t pdf_document_free(zathura_document_t* document, PopplerDocument* poppler_document);
+zathura_error_t pdf_document_free(zathura_document_t* document, pdf_document_t* pdf_document);
+
+/**
+ * Locks the poppler document for the calling thread. Poppler documents must
+ * not be used from several threads at once; the lock may be taken
+ * recursively and must be taken before any other lock of the plugin.
+ *
+ * @param pdf_document The document or NULL
+ */
+void pdf_document_lock(pdf_document_t* pdf_document);
+
+/**
+ * Unlocks the poppler document
+ *
+ * @param pdf_document The document or NULL
+ */
+void pdf_document_unlock(pdf_document_t* pdf_document);
+
+/**
+ * Acquires a poppler document to render a page with. Poppler renders all
+ * pages of a document through a single output device, so renders running at
+ * the same time need documents of their own. If the document is not in use,
+ * it is returned locked. Otherwise an idle copy of the file is returned, or
+ * a new one is opened as long as there are fewer copies than processors.
+ * Only if that fails, the call waits for the lock of the document.
+ *
+ * @param pdf_document The document
+ * @return The poppler document of the document or a copy
+ */
+PopplerDocument* pdf_document_acquire_render_document(pdf_document_t* pdf_document);
+
+/**
+ * Releases a poppler document acquired with
+ * pdf_document_acquire_render_document
+ *
+ * @param pdf_document The document
+ * @param poppler_document The poppler document
+ */
+void pdf_document_release_render_document(pdf_document_t* pdf_document,
+    PopplerDocument* poppler_document);
+
+/**
+ * Stops rendering from copies of the file, e.g. because the document has been
+ * changed in memory. Copies in use are closed when they are released.
+ *
+ * @param pdf_document The document
+ */
+void pdf_document_disable_render_copies(pdf_document_t* pdf_document);
 
 /**
  * Initializes the page with the needed values
@@ -46,7 +260,28 @@ zathura_error_t pdf_page_init(zathura_page_t* page);
  * @return ZATHURA_ERROR_OK when no error occurred, otherwise see
  *    zathura_error_t
  */
-zathura_error_t pdf_page_clear(zathura_page_t* page, PopplerPage* poppler_page);
+zathura_error_t pdf_page_clear(zathura_page_t* page, pdf_page_t* pdf_page);
+
+/**
+ * Returns the poppler page of the given page and loads it if necessary
+ *
+ * @param pdf_page The page
+ * @return A new reference to the poppler page (needs to be released with
+ *   g_object_unref) or NULL if an error occurred
+ */
+PopplerPage* pdf_page_get_poppler_page(pdf_page_t* pdf_page);
+
+/**
+ * Notes that poppler extracted the text of the page. This increases the
+ * memory accounted for the page by the size of the text until it is trimmed.
+ *
+ * @param pdf_page The page
+ * @param poppler_page The poppler page the text has been extracted from
+ * @param text_length Number of characters of the text or -1 if it is not
+ *   known, in which case a typical length is assumed
+ */
+void pdf_page_set_text_loaded(pdf_page_t* pdf_page, PopplerPage* poppler_page,
+    int text_length);
 
 /**
  * Saves the document to the given path
@@ -57,7 +292,7 @@ zathura_error_t pdf_page_clear(zathura_page_t* page, PopplerPage* poppler_page);
  *    zathura_error_t
  */
 zathura_error_t pdf_document_save_as(zathura_document_t* document,
-    PopplerDocument* poppler_document, const char* path);
+    pdf_document_t* pdf_document, const char* path);
 
 /**
  * Generates the index of the document
@@ -69,7 +304,36 @@ zathura_error_t pdf_document_save_as(zathura_document_t* document,
  *   no index)
  */
 girara_tree_node_t* pdf_document_index_generate(zathura_document_t* document,
-    PopplerDocument* poppler_document, zathura_error_t* error);
+    pdf_document_t* pdf_document, zathura_error_t* error);
+
+/**
+ * Generates the index of the document on a worker thread. Progress is
+ * reported as outline entries are built. The document stays usable from
+ * other threads in between entries.
+ *
+ * @param pdf_document The document, needs to stay alive until callback has
+ *   been invoked
+ * @param cancellable Cancellable or NULL
+ * @param progress Progress callback or NULL
+ * @param progress_data Custom data passed to progress
+ * @param callback Callback invoked on the thread-default main context of the
+ *   calling thread, needs to call pdf_document_index_generate_finish
+ * @param data Custom data passed to callback
+ */
+void pdf_document_index_generate_async(pdf_document_t* pdf_document,
+    GCancellable* cancellable, pdf_progress_t progress, void* progress_data,
+    GAsyncReadyCallback callback, void* data);
+
+/**
+ * Finishes generating the index of the document
+ *
+ * @param result The result passed to the callback
+ * @param error Set to an error value (see zathura_error_t) if an
+ *   error occurred or the operation has been cancelled
+ * @return Tree node object or NULL if an error occurred
+ */
+girara_tree_node_t* pdf_document_index_generate_finish(GAsyncResult* result,
+    zathura_error_t* error);
 
 /**
  * Returns a list of attachments included in the zathura document
@@ -80,7 +344,7 @@ girara_tree_node_t* pdf_document_index_generate(zathura_document_t* document,
  * @return List of attachments or NULL if an error occurred
  */
 girara_list_t* pdf_document_attachments_get(zathura_document_t* document,
-    PopplerDocument* poppler_document, zathura_error_t* error);
+    pdf_document_t* pdf_document, zathura_error_t* error);
 
 /**
  * Saves an attachment to a file
@@ -92,7 +356,7 @@ girara_list_t* pdf_document_attachments_get(zathura_document_t* document,
  *    zathura_error_t
  */
 zathura_error_t pdf_document_attachment_save(zathura_document_t*
-    document, PopplerDocument* poppler_document, const char* attachment, const char* filename);
+    document, pdf_document_t* pdf_document, const char* attachment, const char* filename);
 
 /**
  * Returns a list of images included on the zathura page
@@ -103,7 +367,7 @@ zathura_error_t pdf_document_attachment_save(zathura_document_t*
  * @return List of images
  */
 girara_list_t* pdf_page_images_get(zathura_page_t* page,
-    PopplerPage* poppler_page, zathura_error_t* error);
+    pdf_page_t* pdf_page, zathura_error_t* error);
 
 /**
  * Gets the content of the image in a cairo surface
@@ -115,7 +379,7 @@ girara_list_t* pdf_page_images_get(zathura_page_t* page,
  * @return The cairo image surface or NULL if an error occurred
  */
 cairo_surface_t* pdf_page_image_get_cairo(zathura_page_t* page,
-    PopplerPage* poppler_page, zathura_image_t* image, zathura_error_t* error);
+    pdf_page_t* pdf_page, zathura_image_t* image, zathura_error_t* error);
 
 /**
  * Returns a list of document information entries of the document
@@ -126,7 +390,31 @@ cairo_surface_t* pdf_page_image_get_cairo(zathura_page_t* page,
  * @return List of information entries or NULL if an error occurred
  */
 girara_list_t* pdf_document_get_information(zathura_document_t* document,
-    PopplerDocument* poppler_document, zathura_error_t* error);
+    pdf_document_t* pdf_document, zathura_error_t* error);
+
+/**
+ * Collects the document information entries on a worker thread
+ *
+ * @param pdf_document The document, needs to stay alive until callback has
+ *   been invoked
+ * @param cancellable Cancellable or NULL
+ * @param callback Callback invoked on the thread-default main context of the
+ *   calling thread, needs to call pdf_document_get_information_finish
+ * @param data Custom data passed to callback
+ */
+void pdf_document_get_information_async(pdf_document_t* pdf_document,
+    GCancellable* cancellable, GAsyncReadyCallback callback, void* data);
+
+/**
+ * Finishes collecting the document information entries
+ *
+ * @param result The result passed to the callback
+ * @param error Set to an error value (see zathura_error_t) if an
+ *   error occurred or the operation has been cancelled
+ * @return List of information entries or NULL if an error occurred
+ */
+girara_list_t* pdf_document_get_information_finish(GAsyncResult* result,
+    zathura_error_t* error);
 
 /**
  * Searches for a specific text on a page and returns a list of results
@@ -137,8 +425,8 @@ girara_list_t* pdf_document_get_information(zathura_document_t* document,
  *   error occurred
  * @return List of search results or NULL if an error occurred
  */
-girara_list_t* pdf_page_search_text(zathura_page_t* page, PopplerPage*
-    data, const char* text, zathura_error_t* error);
+girara_list_t* pdf_page_search_text(zathura_page_t* page, pdf_page_t*
+    pdf_page, const char* text, zathura_error_t* error);
 
 /**
  * Returns a list of internal/external links that are shown on the given page
@@ -149,7 +437,7 @@ girara_list_t* pdf_page_search_text(zathura_page_t* page, PopplerPage*
  * @return List of links or NULL if an error occurred
  */
 girara_list_t* pdf_page_links_get(zathura_page_t* page,
-    PopplerPage* poppler_page, zathura_error_t* error);
+    pdf_page_t* pdf_page, zathura_error_t* error);
 
 /**
  * Returns a list of form fields available on the given page
@@ -160,7 +448,7 @@ girara_list_t* pdf_page_links_get(zathura_page_t* page,
  * @return List of form fields or NULL if an error occurred
  */
 girara_list_t* pdf_page_form_fields_get(zathura_page_t* page,
-    PopplerPage* poppler_page, zathura_error_t* error);
+    pdf_page_t* pdf_page, zathura_error_t* error);
 
 /**
  * Get text for selection
@@ -170,7 +458,7 @@ girara_list_t* pdf_page_form_fields_get(zathura_page_t* page,
  * occurred
  * @return The selected text (needs to be deallocated with g_free)
  */
-char* pdf_page_get_text(zathura_page_t* page, PopplerPage* poppler_page,
+char* pdf_page_get_text(zathura_page_t* page, pdf_page_t* pdf_page,
     zathura_rectangle_t rectangle, zathura_error_t* error);
 
 /**
@@ -182,7 +470,223 @@ char* pdf_page_get_text(zathura_page_t* page, PopplerPage* poppler_page,
  * @return ZATHURA_ERROR_OK when no error occurred, otherwise see
  *    zathura_error_t
  */
-zathura_error_t pdf_page_render_cairo(zathura_page_t* page, PopplerPage*
-    poppler_page, cairo_t* cairo, bool printing);
+zathura_error_t pdf_page_render_cairo(zathura_page_t* page, pdf_page_t*
+    pdf_page, cairo_t* cairo, bool printing);
+
+/**
+ * Renders a page onto a cairo object using the given render profile
+ *
+ * @param page Page
+ * @param cairo Cairo object
+ * @param profile The render profile
+ * @return ZATHURA_ERROR_OK when no error occurred, otherwise see
+ *    zathura_error_t
+ */
+zathura_error_t pdf_page_render_cairo_with_profile(zathura_page_t* page,
+    pdf_page_t* pdf_page, cairo_t* cairo, pdf_render_profile_t profile);
+
+/**
+ * Sets the render profile used by pdf_page_render_cairo. Hosts set
+ * PDF_RENDER_PROFILE_INTERACTIVE on every scroll or zoom step and
+ * PDF_RENDER_PROFILE_FINAL, followed by a re-render, once the interaction
+ * settled. Any other profile than PDF_RENDER_PROFILE_FINAL only holds for a
+ * short time after it has been set, so the display does not stay degraded if
+ * a host misses to switch back.
+ *
+ * @param pdf_document The document
+ * @param profile The render profile
+ */
+void pdf_document_set_render_profile(pdf_document_t* pdf_document,
+    pdf_render_profile_t profile);
+
+/**
+ * Returns the render profile used by pdf_page_render_cairo
+ *
+ * @param pdf_document The document
+ * @return The render profile
+ */
+pdf_render_profile_t pdf_document_get_render_profile(pdf_document_t* pdf_document);
+
+/**
+ * Looks up a render profile by its name
+ *
+ * @param name Name of the profile ("final" or "interactive")
+ * @return The render profile or PDF_RENDER_PROFILE_FINAL if the name is
+ *   unknown
+ */
+pdf_render_profile_t pdf_render_profile_from_string(const char* name);
+
+/**
+ * Entry of the outline of a document
+ */
+typedef struct pdf_outline_entry_s {
+  char* title; /**< Title of the entry */
+  unsigned int page; /**< Index of the target page or G_MAXUINT if it has none */
+  unsigned int depth; /**< Depth of the entry, 0 for top level entries */
+} pdf_outline_entry_t;
+
+/**
+ * Finds the outline entry a page belongs to, i.e. the last entry in
+ * document order that starts on the page or before it. The outline is kept
+ * in sorted tables, so the lookup takes logarithmic time.
+ *
+ * @param pdf_document The document
+ * @param page Index of the page
+ * @return The entry (needs to be deallocated with pdf_outline_entry_free)
+ *   or NULL if there is none
+ */
+pdf_outline_entry_t* pdf_document_outline_find_page(pdf_document_t*
+    pdf_document, unsigned int page);
+
+/**
+ * Finds the outline entries whose title starts with a prefix. Titles are
+ * compared case insensitively after Unicode normalization.
+ *
+ * @param pdf_document The document
+ * @param prefix The prefix
+ * @return List of pdf_outline_entry_t sorted by title (needs to be
+ *   deallocated with g_list_free_full and pdf_outline_entry_free)
+ */
+GList* pdf_document_outline_find_title(pdf_document_t* pdf_document, const
+    char* prefix);
+
+/**
+ * Frees an outline entry
+ *
+ * @param entry The entry
+ */
+void pdf_outline_entry_free(pdf_outline_entry_t* entry);
+
+/**
+ * Returns the label of a page. The labels of all pages are loaded on the
+ * first lookup.
+ *
+ * @param pdf_document The document
+ * @param index Index of the page
+ * @return The label (needs to be deallocated with g_free) or NULL if the
+ *   page has none
+ */
+char* pdf_document_get_page_label(pdf_document_t* pdf_document, unsigned int
+    index);
+
+/**
+ * Finds the page with a label
+ *
+ * @param pdf_document The document
+ * @param label The label
+ * @param index Set to the index of the first page with the label
+ * @return true if a page has the label
+ */
+bool pdf_document_find_page_label(pdf_document_t* pdf_document, const char*
+    label, unsigned int* index);
+
+/**
+ * Tells the plugin that the annotations of a page have been changed, added,
+ * removed or toggled. From then on the page is rendered as its content
+ * without annotations and a layer covering the areas of annotations other
+ * than links and form fields, so further changes only render those areas
+ * again on top of the cached content. poppler-glib cannot draw annotation
+ * appearance streams on their own, so the layer is a render of the whole page
+ * clipped to the areas. zathura does not call this function, so pages are
+ * only rendered in layers by hosts that edit annotations.
+ *
+ * @param pdf_page The page
+ */
+void pdf_page_annotations_changed(pdf_page_t* pdf_page);
+
+/**
+ * Lists the pages of a document that took longest to render, with the share
+ * of the render time spent on images, masks, path fills and strokes, text and
+ * everything else. Only available if the render profiler has been enabled
+ * with ZATHURA_PDF_POPPLER_RENDER_PROFILER; renders are not cached while it
+ * is enabled.
+ *
+ * @param pdf_document The document
+ * @param count Maximum number of pages to list
+ * @return One line per page, slowest first (needs to be deallocated with
+ *   g_free) or NULL if the profiler is disabled
+ */
+char* pdf_document_get_render_report(pdf_document_t* pdf_document, unsigned
+    int count);
+
+/**
+ * Called by pdf_document_print before a page is written to the print surface
+ *
+ * @param cairo Cairo object of the print surface
+ * @param index Index of the page
+ * @param width Width of the page
+ * @param height Height of the page
+ * @param data Custom data
+ */
+typedef void (*pdf_print_begin_page_t)(cairo_t* cairo, unsigned int index,
+    double width, double height, void* data);
+
+/**
+ * Prints a range of pages. The pages are rendered in parallel while they are
+ * written to the print surface in order, with a bounded number of pages in
+ * flight. cairo_show_page is called after every page.
+ *
+ * zathura does not call this function; it prints through
+ * pdf_page_render_cairo, one page per call. A host that drives the print
+ * surface itself calls it once for the whole range instead. Every worker
+ * renders from its own copy of the document, so fonts and images shared
+ * between pages are decoded again by each worker.
+ *
+ * @param pdf_document The document
+ * @param cairo Cairo object of the print surface
+ * @param first Index of the first page
+ * @param last Index of the last page
+ * @param begin_page Function called before a page is written (e.g. to set the
+ *   page size of the surface) or NULL
+ * @param data Custom data passed to begin_page
+ * @return ZATHURA_ERROR_OK when every page has been printed,
+ *    ZATHURA_ERROR_UNKNOWN if a page could not be rendered or written, otherwise
+ *    see zathura_error_t
+ */
+zathura_error_t pdf_document_print(pdf_document_t* pdf_document, cairo_t*
+    cairo, unsigned int first, unsigned int last, pdf_print_begin_page_t
+    begin_page, void* data);
+
+/**
+ * Called by pdf_document_export_text with the text of every page in order
+ *
+ * @param index Index of the page
+ * @param text UTF-8 text of the page
+ * @param text_layout Rectangle of every character of text or NULL if it has
+ *   not been requested or is not available
+ * @param text_layout_length Number of rectangles in text_layout
+ * @param data Custom data
+ * @return false to stop the export
+ */
+typedef bool (*pdf_export_text_t)(unsigned int index, const char* text, const
+    PopplerRectangle* text_layout, guint text_layout_length, void* data);
+
+/**
+ * Exports the text of the whole document. The pages are extracted in parallel
+ * while they are passed on in order, with a bounded number of pages in
+ * flight, so the memory used does not depend on the size of the document.
+ *
+ * @param pdf_document The document
+ * @param text_layout Set to pass on the rectangle of every character
+ * @param callback Function called with the text of every page
+ * @param data Custom data passed to callback
+ * @return ZATHURA_ERROR_OK when the text of every page has been passed on,
+ *    ZATHURA_ERROR_UNKNOWN if the text of a page could not be extracted or
+ *    callback stopped the export, otherwise see zathura_error_t
+ */
+zathura_error_t pdf_document_export_text(pdf_document_t* pdf_document, bool
+    text_layout, pdf_export_text_t callback, void* data);
+
+/**
+ * Writes the text of the whole document to a file descriptor. Pages are
+ * separated by form feeds.
+ *
+ * @param pdf_document The document
+ * @param fd The file descriptor
+ * @return ZATHURA_ERROR_OK when no error occurred, otherwise see
+ *    zathura_error_t
+ */
+zathura_error_t pdf_document_export_text_to_fd(pdf_document_t* pdf_document,
+    int fd);
 
 #endif // PDF_H
@@ -0,0 +1,107 @@
+/* See LICENSE file for license and copyright information */
+
+#include <girara/utils.h>
+
+#include "plugin.h"
+#include "workers.h"
+
+/**
+ * A page recorded for printing
+ */
+typedef struct print_page_s {
+  cairo_surface_t* recording; /**< Recorded page */
+  double width; /**< Page width */
+  double height; /**< Page height */
+} print_page_t;
+
+/**
+ * The print surface the pages are written to
+ */
+typedef struct print_job_s {
+  cairo_t* cairo; /**< Cairo object of the print surface */
+  pdf_print_begin_page_t begin_page; /**< Function called before a page or NULL */
+  void* data; /**< Custom data passed to begin_page */
+} print_job_t;
+
+static void* record_page(PopplerDocument* poppler_document, unsigned int
+    index, void* data);
+static bool write_page(unsigned int index, void* result, void* data);
+static void print_page_free(void* data);
+
+zathura_error_t
+pdf_document_print(pdf_document_t* pdf_document, cairo_t* cairo, unsigned int
+    first, unsigned int last, pdf_print_begin_page_t begin_page, void* data)
+{
+  if (pdf_document == NULL || cairo == NULL) {
+    return ZATHURA_ERROR_INVALID_ARGUMENTS;
+  }
+
+  print_job_t job = { cairo, begin_page, data };
+
+  return pdf_workers_run(pdf_document, "pdf-print", first, last, record_page,
+      write_page, print_page_free, &job);
+}
+
+static void*
+record_page(PopplerDocument* poppler_document, unsigned int index, void* data)
+{
+  PopplerPage* poppler_page = poppler_document_get_page(poppler_document, index);
+  if (poppler_page == NULL) {
+    girara_warning("Failed to load page %u for printing", index);
+    return NULL;
+  }
+
+  print_page_t* page = g_malloc0(sizeof(print_page_t));
+  poppler_page_get_size(poppler_page, &page->width, &page->height);
+
+  /* the page is recorded as a display list, so the print surface still gets
+   * vector output when it is replayed */
+  const cairo_rectangle_t extents = { 0, 0, page->width, page->height };
+  page->recording = cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA,
+      &extents);
+  cairo_t* cairo = cairo_create(page->recording);
+  poppler_page_render_for_printing(poppler_page, cairo);
+  const cairo_status_t status = cairo_status(cairo);
+  cairo_destroy(cairo);
+
+  g_object_unref(poppler_page);
+
+  if (status != CAIRO_STATUS_SUCCESS ||
+      cairo_surface_status(page->recording) != CAIRO_STATUS_SUCCESS) {
+    girara_warning("Failed to render page %u for printing: %s", index,
+        cairo_status_to_string(status != CAIRO_STATUS_SUCCESS ? status :
+          cairo_surface_status(page->recording)));
+    print_page_free(page);
+    return NULL;
+  }
+
+  return page;
+}
+
+static bool
+write_page(unsigned int index, void* result, void* data)
+{
+  print_page_t* page = result;
+  print_job_t* job   = data;
+
+  if (job->begin_page != NULL) {
+    job->begin_page(job->cairo, index, page->width, page->height, job->data);
+  }
+
+  cairo_save(job->cairo);
+  cairo_set_source_surface(job->cairo, page->recording, 0, 0);
+  cairo_paint(job->cairo);
+  cairo_restore(job->cairo);
+  cairo_show_page(job->cairo);
+
+  return cairo_status(job->cairo) == CAIRO_STATUS_SUCCESS;
+}
+
+static void
+print_page_free(void* data)
+{
+  print_page_t* page = data;
+
+  cairo_surface_destroy(page->recording);
+  g_free(page);
+}
@@ -0,0 +1,218 @@
+/* See LICENSE file for license and copyright information */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <girara/utils.h>
+
+#include "profiler.h"
+#include "utils.h"
+
+#define PROFILER_REPORT_PAGES 10
+
+/**
+ * Accumulated timings of a page
+ */
+typedef struct profiler_page_s {
+  unsigned int index; /**< Index of the page */
+  unsigned int renders; /**< Number of renders */
+  gint64 total; /**< Total time in microseconds */
+  gint64 time[PDF_PROFILER_CATEGORIES]; /**< Time per category in microseconds */
+} profiler_page_t;
+
+struct pdf_profiler_s {
+  GMutex lock; /**< Lock for pages */
+  profiler_page_t* pages; /**< Timings of every page */
+  unsigned int number_of_pages; /**< Number of pages */
+};
+
+static const char* category_names[PDF_PROFILER_CATEGORIES] = {
+  [PDF_PROFILER_IMAGES]  = "images",
+  [PDF_PROFILER_MASKS]   = "masks",
+  [PDF_PROFILER_FILLS]   = "fills",
+  [PDF_PROFILER_STROKES] = "strokes",
+  [PDF_PROFILER_TEXT]    = "text",
+  [PDF_PROFILER_OTHER]   = "other"
+};
+
+static void add_time(pdf_profiler_sample_t* sample, pdf_profiler_category_t category);
+static void on_paint(cairo_surface_t* observer, cairo_surface_t* target, void* data);
+static void on_mask(cairo_surface_t* observer, cairo_surface_t* target, void* data);
+static void on_fill(cairo_surface_t* observer, cairo_surface_t* target, void* data);
+static void on_stroke(cairo_surface_t* observer, cairo_surface_t* target, void* data);
+static void on_glyphs(cairo_surface_t* observer, cairo_surface_t* target, void* data);
+static gint compare_pages(gconstpointer a, gconstpointer b);
+static char* profiler_report(pdf_profiler_t* profiler, unsigned int count);
+
+pdf_profiler_t*
+pdf_profiler_new(unsigned int number_of_pages)
+{
+  if (pdf_option_enabled(PDF_RENDER_PROFILER_OPTION) == false) {
+    return NULL;
+  }
+
+  pdf_profiler_t* profiler  = g_malloc0(sizeof(pdf_profiler_t));
+  profiler->pages           = g_malloc0(sizeof(profiler_page_t) * MAX(number_of_pages, 1));
+  profiler->number_of_pages = number_of_pages;
+  g_mutex_init(&profiler->lock);
+
+  for (unsigned int i = 0; i < number_of_pages; i++) {
+    profiler->pages[i].index = i;
+  }
+
+  return profiler;
+}
+
+void
+pdf_profiler_free(pdf_profiler_t* profiler)
+{
+  if (profiler == NULL) {
+    return;
+  }
+
+  char* report = profiler_report(profiler, PROFILER_REPORT_PAGES);
+  if (report != NULL && *report != '\0') {
+    girara_info("Slowest pages:\n%s", report);
+  }
+  g_free(report);
+
+  g_mutex_clear(&profiler->lock);
+  g_free(profiler->pages);
+  g_free(profiler);
+}
+
+cairo_surface_t*
+pdf_profiler_begin(cairo_surface_t* target, pdf_profiler_sample_t* sample)
+{
+  *sample       = (pdf_profiler_sample_t) { 0 };
+  sample->start = g_get_monotonic_time();
+  sample->last  = sample->start;
+
+  /* the callbacks run after every drawing operation */
+  cairo_surface_t* observer = cairo_surface_create_observer(target,
+      CAIRO_SURFACE_OBSERVER_NORMAL);
+  cairo_surface_observer_add_paint_callback(observer, on_paint, sample);
+  cairo_surface_observer_add_mask_callback(observer, on_mask, sample);
+  cairo_surface_observer_add_fill_callback(observer, on_fill, sample);
+  cairo_surface_observer_add_stroke_callback(observer, on_stroke, sample);
+  cairo_surface_observer_add_glyphs_callback(observer, on_glyphs, sample);
+
+  return observer;
+}
+
+void
+pdf_profiler_end(pdf_profiler_t* profiler, unsigned int index, cairo_surface_t*
+    surface, pdf_profiler_sample_t* sample)
+{
+  cairo_surface_finish(surface);
+  cairo_surface_destroy(surface);
+  add_time(sample, PDF_PROFILER_OTHER);
+
+  if (index >= profiler->number_of_pages) {
+    return;
+  }
+
+  g_mutex_lock(&profiler->lock);
+  profiler_page_t* page = &profiler->pages[index];
+  page->renders++;
+  page->total += sample->last - sample->start;
+  for (unsigned int i = 0; i < PDF_PROFILER_CATEGORIES; i++) {
+    page->time[i] += sample->time[i];
+  }
+  g_mutex_unlock(&profiler->lock);
+
+  girara_debug("Profiled page %u: %.2f ms", index, (sample->last - sample->start) / 1000.0);
+}
+
+char*
+pdf_document_get_render_report(pdf_document_t* pdf_document, unsigned int count)
+{
+  if (pdf_document == NULL || pdf_document->profiler == NULL) {
+    return NULL;
+  }
+
+  return profiler_report(pdf_document->profiler, count);
+}
+
+static char*
+profiler_report(pdf_profiler_t* profiler, unsigned int count)
+{
+  profiler_page_t* pages = g_malloc(sizeof(profiler_page_t) * MAX(profiler->number_of_pages, 1));
+
+  g_mutex_lock(&profiler->lock);
+  memcpy(pages, profiler->pages, sizeof(profiler_page_t) * profiler->number_of_pages);
+  g_mutex_unlock(&profiler->lock);
+
+  qsort(pages, profiler->number_of_pages, sizeof(profiler_page_t), compare_pages);
+
+  GString* report = g_string_new(NULL);
+  for (unsigned int i = 0; i < MIN(count, profiler->number_of_pages); i++) {
+    const profiler_page_t* page = &pages[i];
+    if (page->renders == 0) {
+      break;
+    }
+
+    g_string_append_printf(report, "page %u: %.2f ms per render (%u renders)",
+        page->index + 1, page->total / 1000.0 / page->renders, page->renders);
+    for (unsigned int j = 0; j < PDF_PROFILER_CATEGORIES; j++) {
+      g_string_append_printf(report, "%s %s %.0f%%", j == 0 ? "," : ";",
+          category_names[j], page->total > 0 ? 100.0 * page->time[j] / page->total : 0.0);
+    }
+    g_string_append_c(report, '\n');
+  }
+
+  g_free(pages);
+
+  return g_string_free(report, FALSE);
+}
+
+static void
+add_time(pdf_profiler_sample_t* sample, pdf_profiler_category_t category)
+{
+  const gint64 now = g_get_monotonic_time();
+
+  sample->time[category] += now - sample->last;
+  sample->last            = now;
+}
+
+static void
+on_paint(cairo_surface_t* observer, cairo_surface_t* target, void* data)
+{
+  add_time(data, PDF_PROFILER_IMAGES);
+}
+
+static void
+on_mask(cairo_surface_t* observer, cairo_surface_t* target, void* data)
+{
+  add_time(data, PDF_PROFILER_MASKS);
+}
+
+static void
+on_fill(cairo_surface_t* observer, cairo_surface_t* target, void* data)
+{
+  add_time(data, PDF_PROFILER_FILLS);
+}
+
+static void
+on_stroke(cairo_surface_t* observer, cairo_surface_t* target, void* data)
+{
+  add_time(data, PDF_PROFILER_STROKES);
+}
+
+static void
+on_glyphs(cairo_surface_t* observer, cairo_surface_t* target, void* data)
+{
+  add_time(data, PDF_PROFILER_TEXT);
+}
+
+static gint
+compare_pages(gconstpointer a, gconstpointer b)
+{
+  const profiler_page_t* page_a = a;
+  const profiler_page_t* page_b = b;
+
+  const gint64 time_a = page_a->renders > 0 ? page_a->total / page_a->renders : 0;
+  const gint64 time_b = page_b->renders > 0 ? page_b->total / page_b->renders : 0;
+
+  return time_a < time_b ? 1 : (time_a > time_b ? -1 : 0);
+}
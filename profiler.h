@@ -0,0 +1,73 @@
+/* See LICENSE file for license and copyright information */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "plugin.h"
+
+/**
+ * Name of the environment variable that enables the render profiler
+ */
+#define PDF_RENDER_PROFILER_OPTION "ZATHURA_PDF_POPPLER_RENDER_PROFILER"
+
+/**
+ * Categories render time is attributed to
+ */
+typedef enum pdf_profiler_category_e {
+  PDF_PROFILER_IMAGES, /**< Images, shadings and composited groups */
+  PDF_PROFILER_MASKS, /**< Soft masks and transparency */
+  PDF_PROFILER_FILLS, /**< Filled paths */
+  PDF_PROFILER_STROKES, /**< Stroked paths */
+  PDF_PROFILER_TEXT, /**< Glyphs */
+  PDF_PROFILER_OTHER, /**< Time after the last drawing operation */
+  PDF_PROFILER_CATEGORIES /**< Number of categories */
+} pdf_profiler_category_t;
+
+/**
+ * Timings of a single render
+ */
+typedef struct pdf_profiler_sample_s {
+  gint64 start; /**< Start of the render */
+  gint64 last; /**< End of the last drawing operation */
+  gint64 time[PDF_PROFILER_CATEGORIES]; /**< Time per category in microseconds */
+} pdf_profiler_sample_t;
+
+/**
+ * Creates the profiler of a document if it is enabled in the environment
+ *
+ * @param number_of_pages Number of pages of the document
+ * @return The profiler or NULL if it is disabled
+ */
+pdf_profiler_t* pdf_profiler_new(unsigned int number_of_pages);
+
+/**
+ * Frees a profiler
+ *
+ * @param profiler The profiler
+ */
+void pdf_profiler_free(pdf_profiler_t* profiler);
+
+/**
+ * Starts timing a render. Drawing operations on the returned surface are
+ * passed on to target. The time poppler spends before a drawing operation,
+ * e.g. decoding an image or loading a font, is attributed to that operation.
+ *
+ * @param target The render target
+ * @param sample The sample to fill in
+ * @return Surface to render to (needs to be passed to pdf_profiler_end)
+ */
+cairo_surface_t* pdf_profiler_begin(cairo_surface_t* target,
+    pdf_profiler_sample_t* sample);
+
+/**
+ * Finishes timing a render and adds it to the statistics of the page
+ *
+ * @param profiler The profiler
+ * @param index Index of the page
+ * @param surface Surface returned by pdf_profiler_begin
+ * @param sample The sample
+ */
+void pdf_profiler_end(pdf_profiler_t* profiler, unsigned int index,
+    cairo_surface_t* surface, pdf_profiler_sample_t* sample);
+
+#endif // PROFILER_H
@@ -1,20 +1,647 @@
 /* See LICENSE file for license and copyright information */
 
 #include "plugin.h"
+#include "pagecache.h"
+#include "profiler.h"
+
+/* Margin around annotations in points, for borders drawn outside their area */
+#define ANNOTATION_MARGIN 1.0
+/* Time in microseconds a profile other than the final one holds after it has
+ * been set */
+#define RENDER_PROFILE_TIMEOUT (500 * 1000)
+/* Estimated memory of a recorded path or glyph run in bytes */
+#define RECORDING_OPERATION_SIZE 256
+/* Pages are recorded at the power of two at or above the scale of a render,
+ * as poppler reduces images to the resolution it renders at and widens
+ * hairlines to a pixel. Renders up to half that scale replay the recording,
+ * so zooming only records a page again when it crosses a power of two. */
+#define RECORDING_SCALE_MIN (1.0 / 16)
+#define RECORDING_SCALE_MAX 16.0
+
+/**
+ * Settings of a render profile
+ */
+typedef struct render_profile_s {
+  const char* name; /**< Name of the profile */
+  cairo_antialias_t antialias; /**< Antialiasing of paths and text */
+  double resolution; /**< Resolution relative to the target surface */
+  cairo_filter_t filter; /**< Filter used to scale to the target resolution */
+  bool annotations; /**< Render annotations */
+} render_profile_t;
+
+/**
+ * Operations seen while a page is recorded
+ */
+typedef struct recording_counts_s {
+  unsigned int operations; /**< Number of fills, strokes and glyph runs */
+  unsigned int images; /**< Number of paints and masks */
+} recording_counts_t;
+
+static const render_profile_t render_profiles[] = {
+  [PDF_RENDER_PROFILE_FINAL] = {
+    .name        = "final",
+    .antialias   = CAIRO_ANTIALIAS_DEFAULT,
+    .resolution  = 1.0,
+    .filter      = CAIRO_FILTER_GOOD,
+    .annotations = true
+  },
+  [PDF_RENDER_PROFILE_INTERACTIVE] = {
+    .name        = "interactive",
+    .antialias   = CAIRO_ANTIALIAS_FAST,
+    .resolution  = 0.5,
+    .filter      = CAIRO_FILTER_FAST,
+    .annotations = false
+  }
+};
+
+static PopplerPage* get_render_page(pdf_page_t* pdf_page, PopplerDocument*
+    poppler_document);
+static zathura_error_t render_page_with_profile(pdf_page_t* pdf_page,
+    PopplerPage* poppler_page, cairo_t* cairo, pdf_render_profile_t profile);
+static void render_page(PopplerPage* poppler_page, cairo_t* cairo, const
+    render_profile_t* profile);
+static double recording_scale(const cairo_matrix_t* matrix);
+static cairo_surface_t* get_recording(pdf_page_t* pdf_page, PopplerPage*
+    poppler_page, double scale, pdf_render_profile_t profile);
+static void count_operation(cairo_surface_t* observer, cairo_surface_t*
+    target, void* data);
+static void count_image(cairo_surface_t* observer, cairo_surface_t* target,
+    void* data);
+static void draw_page(pdf_page_t* pdf_page, PopplerPage* poppler_page,
+    cairo_t* cairo, pdf_render_profile_t profile);
+static void render_page_scaled(pdf_page_t* pdf_page, PopplerPage* poppler_page,
+    cairo_t* cairo, pdf_render_profile_t profile);
+static void render_page_image(pdf_page_t* pdf_page, PopplerPage* poppler_page,
+    cairo_t* cairo, pdf_render_profile_t profile);
+static bool render_page_layered(pdf_page_t* pdf_page, PopplerPage*
+    poppler_page, cairo_t* cairo, pdf_render_profile_t profile);
+#if POPPLER_CHECK_VERSION(22, 2, 0)
+static cairo_surface_t* render_annotations(PopplerPage* poppler_page, GList*
+    annotations, cairo_surface_t* content, const cairo_matrix_t* matrix, const
+    render_profile_t* settings);
+#endif
+static void render_page_profiled(pdf_page_t* pdf_page, PopplerPage*
+    poppler_page, cairo_t* cairo, pdf_render_profile_t profile);
+static void render_page_cached(pdf_page_t* pdf_page, PopplerPage* poppler_page,
+    cairo_t* cairo, pdf_render_profile_t profile);
 
 zathura_error_t
-pdf_page_render_cairo(zathura_page_t* page, PopplerPage* poppler_page, cairo_t*
+pdf_page_render_cairo(zathura_page_t* page, pdf_page_t* pdf_page, cairo_t*
     cairo, bool printing)
 {
-  if (page == NULL || poppler_page == NULL || cairo == NULL) {
+  if (page == NULL || pdf_page == NULL || cairo == NULL) {
     return ZATHURA_ERROR_INVALID_ARGUMENTS;
   }
 
-  if (printing == false) {
-    poppler_page_render(poppler_page, cairo);
-  } else {
-    poppler_page_render_for_printing(poppler_page, cairo);
+  if (printing == true) {
+    PopplerDocument* poppler_document =
+      pdf_document_acquire_render_document(pdf_page->document);
+    PopplerPage* poppler_page = get_render_page(pdf_page, poppler_document);
+    if (poppler_page != NULL) {
+      poppler_page_render_for_printing(poppler_page, cairo);
+      g_object_unref(poppler_page);
+    }
+    pdf_document_release_render_document(pdf_page->document, poppler_document);
+
+    return poppler_page != NULL ? ZATHURA_ERROR_OK : ZATHURA_ERROR_UNKNOWN;
+  }
+
+  return pdf_page_render_cairo_with_profile(page, pdf_page, cairo,
+      pdf_document_get_render_profile(pdf_page->document));
+}
+
+zathura_error_t
+pdf_page_render_cairo_with_profile(zathura_page_t* page, pdf_page_t* pdf_page,
+    cairo_t* cairo, pdf_render_profile_t profile)
+{
+  if (page == NULL || pdf_page == NULL || cairo == NULL ||
+      profile >= G_N_ELEMENTS(render_profiles)) {
+    return ZATHURA_ERROR_INVALID_ARGUMENTS;
+  }
+
+  PopplerDocument* poppler_document =
+    pdf_document_acquire_render_document(pdf_page->document);
+  PopplerPage* poppler_page = get_render_page(pdf_page, poppler_document);
+
+  zathura_error_t error = ZATHURA_ERROR_UNKNOWN;
+  if (poppler_page != NULL) {
+    error = render_page_with_profile(pdf_page, poppler_page, cairo, profile);
+    g_object_unref(poppler_page);
+  }
+
+  pdf_document_release_render_document(pdf_page->document, poppler_document);
+
+  return error;
+}
+
+void
+pdf_page_annotations_changed(pdf_page_t* pdf_page)
+{
+  if (pdf_page == NULL) {
+    return;
+  }
+
+  /* copies of the file do not have the changes */
+  pdf_document_disable_render_copies(pdf_page->document);
+
+  /* from now on the page is rendered in layers, so the next change only
+   * renders the area of the annotations again */
+  g_mutex_lock(&pdf_page->lock);
+  pdf_page->annotations_edited = true;
+  g_mutex_unlock(&pdf_page->lock);
+
+  pdf_page_cache_clear_annotations(pdf_page);
+}
+
+void
+pdf_document_set_render_profile(pdf_document_t* pdf_document,
+    pdf_render_profile_t profile)
+{
+  if (pdf_document == NULL || profile >= G_N_ELEMENTS(render_profiles)) {
+    return;
+  }
+
+  g_mutex_lock(&pdf_document->render_profile_lock);
+  pdf_document->render_profile        = profile;
+  pdf_document->render_profile_expiry = g_get_monotonic_time() + RENDER_PROFILE_TIMEOUT;
+  g_mutex_unlock(&pdf_document->render_profile_lock);
+}
+
+pdf_render_profile_t
+pdf_document_get_render_profile(pdf_document_t* pdf_document)
+{
+  if (pdf_document == NULL) {
+    return PDF_RENDER_PROFILE_FINAL;
+  }
+
+  g_mutex_lock(&pdf_document->render_profile_lock);
+  pdf_render_profile_t profile = pdf_document->render_profile;
+  if (profile != PDF_RENDER_PROFILE_FINAL &&
+      g_get_monotonic_time() >= pdf_document->render_profile_expiry) {
+    profile = PDF_RENDER_PROFILE_FINAL;
+  }
+  g_mutex_unlock(&pdf_document->render_profile_lock);
+
+  return profile;
+}
+
+pdf_render_profile_t
+pdf_render_profile_from_string(const char* name)
+{
+  for (unsigned int i = 0; i < G_N_ELEMENTS(render_profiles); i++) {
+    if (g_strcmp0(render_profiles[i].name, name) == 0) {
+      return i;
+    }
+  }
+
+  return PDF_RENDER_PROFILE_FINAL;
+}
+
+static PopplerPage*
+get_render_page(pdf_page_t* pdf_page, PopplerDocument* poppler_document)
+{
+  if (poppler_document == pdf_page->document->poppler_document) {
+    return pdf_page_get_poppler_page(pdf_page);
+  }
+
+  return poppler_document_get_page(poppler_document, pdf_page->index);
+}
+
+static zathura_error_t
+render_page_with_profile(pdf_page_t* pdf_page, PopplerPage* poppler_page,
+    cairo_t* cairo, pdf_render_profile_t profile)
+{
+  /* renders are timed from scratch, without any of the caches */
+  if (pdf_page->document->profiler != NULL) {
+    render_page_profiled(pdf_page, poppler_page, cairo, profile);
+    return ZATHURA_ERROR_OK;
   }
 
+  cairo_surface_t* target = cairo_get_target(cairo);
+  if (cairo_surface_get_type(target) != CAIRO_SURFACE_TYPE_IMAGE) {
+    draw_page(pdf_page, poppler_page, cairo, profile);
+    return ZATHURA_ERROR_OK;
+  }
+
+  if (pdf_page_cache_paint(pdf_page, cairo, profile) == true) {
+    return ZATHURA_ERROR_OK;
+  }
+
+  /* pages whose annotations are being edited keep their content and their
+   * annotations apart */
+  if (render_page_layered(pdf_page, poppler_page, cairo, profile) == true) {
+    return ZATHURA_ERROR_OK;
+  }
+
+  /* zathura keeps rendered pages itself, so pages are only rendered into
+   * images of their own if they are kept */
+  if (pdf_page->document->image_cache_enabled == false) {
+    draw_page(pdf_page, poppler_page, cairo, profile);
+    return ZATHURA_ERROR_OK;
+  }
+
+  render_page_cached(pdf_page, poppler_page, cairo, profile);
+
   return ZATHURA_ERROR_OK;
 }
+
+static void
+render_page(PopplerPage* poppler_page, cairo_t* cairo, const render_profile_t*
+    profile)
+{
+  cairo_save(cairo);
+
+  /* poppler takes the antialiasing of paths and text from the context */
+  cairo_font_options_t* font_options = cairo_font_options_create();
+  cairo_font_options_set_antialias(font_options, profile->antialias);
+  cairo_set_font_options(cairo, font_options);
+  cairo_font_options_destroy(font_options);
+  cairo_set_antialias(cairo, profile->antialias);
+
+#if POPPLER_CHECK_VERSION(22, 2, 0)
+  poppler_page_render_full(poppler_page, cairo, FALSE, profile->annotations == true ?
+      POPPLER_RENDER_ANNOTS_ALL : POPPLER_RENDER_ANNOTS_NONE);
+#else
+  poppler_page_render(poppler_page, cairo);
+#endif
+
+  cairo_restore(cairo);
+}
+
+static double
+recording_scale(const cairo_matrix_t* matrix)
+{
+  /* the larger of the scales along the two axes of the page, squared */
+  const double x = matrix->xx * matrix->xx + matrix->yx * matrix->yx;
+  const double y = matrix->xy * matrix->xy + matrix->yy * matrix->yy;
+  const double target = MAX(x, y);
+
+  double scale = 1.0;
+  while (scale * scale < target && scale < RECORDING_SCALE_MAX) {
+    scale *= 2;
+  }
+  while (scale * scale >= 4 * target && scale > RECORDING_SCALE_MIN) {
+    scale /= 2;
+  }
+
+  return scale;
+}
+
+static cairo_surface_t*
+get_recording(pdf_page_t* pdf_page, PopplerPage* poppler_page, double scale,
+    pdf_render_profile_t profile)
+{
+  cairo_surface_t* recording = pdf_page_cache_get_recording(pdf_page, scale,
+      profile);
+  if (recording != NULL) {
+    return recording;
+  }
+
+  double width  = 0;
+  double height = 0;
+  poppler_page_get_size(poppler_page, &width, &height);
+  const cairo_rectangle_t extents = { 0, 0, width * scale, height * scale };
+
+  recording = cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA, &extents);
+
+  /* cairo does not report the size of a recording, so it is estimated from
+   * the operations recorded. Images are at most as large as the page at the
+   * scale of the recording. */
+  recording_counts_t counts = { 0, 0 };
+  cairo_surface_t* observer = cairo_surface_create_observer(recording,
+      CAIRO_SURFACE_OBSERVER_NORMAL);
+  cairo_surface_observer_add_fill_callback(observer, count_operation, &counts);
+  cairo_surface_observer_add_stroke_callback(observer, count_operation, &counts);
+  cairo_surface_observer_add_glyphs_callback(observer, count_operation, &counts);
+  cairo_surface_observer_add_paint_callback(observer, count_image, &counts);
+  cairo_surface_observer_add_mask_callback(observer, count_image, &counts);
+
+  cairo_t* record = cairo_create(observer);
+  cairo_scale(record, scale, scale);
+  render_page(poppler_page, record, &render_profiles[profile]);
+  cairo_destroy(record);
+  cairo_surface_destroy(observer);
+
+  if (cairo_surface_status(recording) != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy(recording);
+    return NULL;
+  }
+
+  const size_t size = (size_t) counts.operations * RECORDING_OPERATION_SIZE +
+    (size_t) counts.images * 4 * (size_t) (extents.width * extents.height);
+  pdf_page_cache_set_recording(pdf_page, recording, scale, profile, size);
+
+  return recording;
+}
+
+static void
+count_operation(cairo_surface_t* observer, cairo_surface_t* target, void* data)
+{
+  recording_counts_t* counts = data;
+  counts->operations++;
+}
+
+static void
+count_image(cairo_surface_t* observer, cairo_surface_t* target, void* data)
+{
+  recording_counts_t* counts = data;
+  counts->images++;
+}
+
+static void
+draw_page(pdf_page_t* pdf_page, PopplerPage* poppler_page, cairo_t* cairo,
+    pdf_render_profile_t profile)
+{
+  /* the content stream is interpreted once per page, profile and scale
+   * bucket, later renders at any zoom level and rotation replay the recorded
+   * operations */
+  cairo_matrix_t matrix;
+  cairo_get_matrix(cairo, &matrix);
+  const double scale = recording_scale(&matrix);
+
+  cairo_surface_t* recording = NULL;
+  if (pdf_page->document->display_list_enabled == true) {
+    recording = get_recording(pdf_page, poppler_page, scale, profile);
+  }
+
+  if (recording == NULL) {
+    render_page(poppler_page, cairo, &render_profiles[profile]);
+    return;
+  }
+
+  cairo_save(cairo);
+  cairo_scale(cairo, 1 / scale, 1 / scale);
+  cairo_set_source_surface(cairo, recording, 0, 0);
+  cairo_paint(cairo);
+  cairo_restore(cairo);
+
+  cairo_surface_destroy(recording);
+}
+
+static void
+render_page_scaled(pdf_page_t* pdf_page, PopplerPage* poppler_page, cairo_t*
+    cairo, pdf_render_profile_t profile_id)
+{
+  const render_profile_t* profile = &render_profiles[profile_id];
+  cairo_surface_t* target = cairo_get_target(cairo);
+  const int width  = cairo_image_surface_get_width(target) * profile->resolution + 1;
+  const int height = cairo_image_surface_get_height(target) * profile->resolution + 1;
+
+  cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+  if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy(surface);
+    draw_page(pdf_page, poppler_page, cairo, profile_id);
+    return;
+  }
+
+  /* render with the transformation of the target at a lower resolution ... */
+  cairo_matrix_t matrix;
+  cairo_get_matrix(cairo, &matrix);
+
+  cairo_t* scaled = cairo_create(surface);
+  cairo_scale(scaled, profile->resolution, profile->resolution);
+  cairo_transform(scaled, &matrix);
+  draw_page(pdf_page, poppler_page, scaled, profile_id);
+  cairo_destroy(scaled);
+
+  /* ... and scale the result up */
+  cairo_save(cairo);
+  cairo_identity_matrix(cairo);
+  cairo_scale(cairo, 1.0 / profile->resolution, 1.0 / profile->resolution);
+  cairo_set_source_surface(cairo, surface, 0, 0);
+  cairo_pattern_set_filter(cairo_get_source(cairo), profile->filter);
+  cairo_paint(cairo);
+  cairo_restore(cairo);
+
+  cairo_surface_destroy(surface);
+}
+
+static void
+render_page_image(pdf_page_t* pdf_page, PopplerPage* poppler_page, cairo_t*
+    cairo, pdf_render_profile_t profile)
+{
+  if (render_profiles[profile].resolution < 1.0) {
+    render_page_scaled(pdf_page, poppler_page, cairo, profile);
+  } else {
+    draw_page(pdf_page, poppler_page, cairo, profile);
+  }
+}
+
+static void
+render_page_cached(pdf_page_t* pdf_page, PopplerPage* poppler_page, cairo_t*
+    cairo, pdf_render_profile_t profile)
+{
+  cairo_surface_t* target = cairo_get_target(cairo);
+  const int width         = cairo_image_surface_get_width(target);
+  const int height        = cairo_image_surface_get_height(target);
+
+  cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+      width, height);
+  if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy(surface);
+    render_page_image(pdf_page, poppler_page, cairo, profile);
+    return;
+  }
+
+  /* render into an image of our own that is kept for the next request */
+  cairo_matrix_t matrix;
+  cairo_get_matrix(cairo, &matrix);
+
+  cairo_t* image = cairo_create(surface);
+  cairo_set_matrix(image, &matrix);
+  render_page_image(pdf_page, poppler_page, image, profile);
+  cairo_destroy(image);
+
+  cairo_save(cairo);
+  cairo_identity_matrix(cairo);
+  cairo_set_source_surface(cairo, surface, 0, 0);
+  cairo_paint(cairo);
+  cairo_restore(cairo);
+
+  pdf_page_cache_set_surface(pdf_page, surface, &matrix, profile);
+  cairo_surface_destroy(surface);
+}
+
+static void
+render_page_profiled(pdf_page_t* pdf_page, PopplerPage* poppler_page, cairo_t*
+    cairo, pdf_render_profile_t profile)
+{
+  pdf_profiler_sample_t sample;
+  cairo_surface_t* surface = pdf_profiler_begin(cairo_get_target(cairo), &sample);
+
+  cairo_matrix_t matrix;
+  cairo_get_matrix(cairo, &matrix);
+
+  cairo_t* observed = cairo_create(surface);
+  cairo_set_matrix(observed, &matrix);
+  render_page(poppler_page, observed, &render_profiles[profile]);
+  cairo_destroy(observed);
+
+  pdf_profiler_end(pdf_page->document->profiler, pdf_page->index, surface, &sample);
+}
+
+static bool
+render_page_layered(pdf_page_t* pdf_page, PopplerPage* poppler_page, cairo_t*
+    cairo, pdf_render_profile_t profile)
+{
+#if POPPLER_CHECK_VERSION(22, 2, 0)
+  const render_profile_t* settings = &render_profiles[profile];
+  if (settings->annotations == false || settings->resolution < 1.0) {
+    return false;
+  }
+
+  /* splitting a page costs a second pass over its content, which only pays
+   * off once its annotations are edited */
+  g_mutex_lock(&pdf_page->lock);
+  const bool edited = pdf_page->annotations_edited;
+  g_mutex_unlock(&pdf_page->lock);
+  if (edited == false) {
+    return false;
+  }
+
+  /* links and form fields are part of most pages and are not edited in the
+   * viewer, only pages with other annotations are split into layers */
+  GList* annot_mapping = poppler_page_get_annot_mapping(poppler_page);
+  GList* annotations   = NULL;
+  for (GList* link = annot_mapping; link != NULL; link = g_list_next(link)) {
+    PopplerAnnotMapping* mapping = link->data;
+    const PopplerAnnotType type  = poppler_annot_get_annot_type(mapping->annot);
+    if (type != POPPLER_ANNOT_LINK && type != POPPLER_ANNOT_WIDGET) {
+      annotations = g_list_prepend(annotations, mapping);
+    }
+  }
+
+  if (annotations == NULL) {
+    poppler_page_free_annot_mapping(annot_mapping);
+    return false;
+  }
+
+  cairo_surface_t* target = cairo_get_target(cairo);
+  const int width  = cairo_image_surface_get_width(target);
+  const int height = cairo_image_surface_get_height(target);
+
+  cairo_matrix_t matrix;
+  cairo_get_matrix(cairo, &matrix);
+
+  /* the content layer is kept when the annotations change ... */
+  cairo_surface_t* content = pdf_page_cache_get_content(pdf_page, width,
+      height, &matrix, profile);
+  if (content == NULL) {
+    content = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+    if (cairo_surface_status(content) != CAIRO_STATUS_SUCCESS) {
+      cairo_surface_destroy(content);
+      g_list_free(annotations);
+      poppler_page_free_annot_mapping(annot_mapping);
+      return false;
+    }
+
+    render_profile_t content_settings = *settings;
+    content_settings.annotations      = false;
+
+    cairo_t* layer = cairo_create(content);
+    cairo_set_matrix(layer, &matrix);
+    render_page(poppler_page, layer, &content_settings);
+    cairo_destroy(layer);
+
+    pdf_page_cache_set_content(pdf_page, content, &matrix, profile);
+  }
+
+  /* ... and only the area of the annotations is rendered again when they
+   * do */
+  cairo_surface_t* layer = pdf_page_cache_get_annotations(pdf_page, width,
+      height, &matrix, profile);
+  if (layer == NULL) {
+    layer = render_annotations(poppler_page, annotations, content, &matrix,
+        settings);
+    pdf_page_cache_set_annotations(pdf_page, layer, &matrix, profile);
+  }
+
+  pdf_page_cache_paint_layers(cairo, content, layer);
+
+  cairo_surface_destroy(layer);
+  cairo_surface_destroy(content);
+  g_list_free(annotations);
+  poppler_page_free_annot_mapping(annot_mapping);
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+#if POPPLER_CHECK_VERSION(22, 2, 0)
+static cairo_surface_t*
+render_annotations(PopplerPage* poppler_page, GList* annotations,
+    cairo_surface_t* content, const cairo_matrix_t* matrix, const
+    render_profile_t* settings)
+{
+  const int width  = cairo_image_surface_get_width(content);
+  const int height = cairo_image_surface_get_height(content);
+
+  /* the layer covers the annotations in device space. Annotation areas use
+   * PDF coordinates with the origin in the bottom left corner. */
+  double page_height = 0;
+  poppler_page_get_size(poppler_page, NULL, &page_height);
+
+  double x1 = width;
+  double y1 = height;
+  double x2 = 0;
+  double y2 = 0;
+  for (GList* link = annotations; link != NULL; link = g_list_next(link)) {
+    PopplerAnnotMapping* mapping = link->data;
+    double x[4] = { mapping->area.x1 - ANNOTATION_MARGIN, mapping->area.x2 +
+      ANNOTATION_MARGIN, mapping->area.x1 - ANNOTATION_MARGIN, mapping->area.x2 +
+      ANNOTATION_MARGIN };
+    double y[4] = { page_height - mapping->area.y2 - ANNOTATION_MARGIN,
+      page_height - mapping->area.y2 - ANNOTATION_MARGIN, page_height -
+      mapping->area.y1 + ANNOTATION_MARGIN, page_height - mapping->area.y1 +
+      ANNOTATION_MARGIN };
+
+    for (unsigned int i = 0; i < 4; i++) {
+      cairo_matrix_transform_point(matrix, &x[i], &y[i]);
+      x1 = MIN(x1, x[i]);
+      y1 = MIN(y1, y[i]);
+      x2 = MAX(x2, x[i]);
+      y2 = MAX(y2, y[i]);
+    }
+  }
+
+  /* whole pixels within the target, an empty layer if the annotations are
+   * outside of it */
+  const int left   = CLAMP((int) x1, 0, width);
+  const int top    = CLAMP((int) y1, 0, height);
+  const int right  = CLAMP((int) x2 + 1, left, width);
+  const int bottom = CLAMP((int) y2 + 1, top, height);
+
+  cairo_surface_t* layer = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+      right - left, bottom - top);
+  cairo_surface_set_device_offset(layer, -left, -top);
+
+  /* the layer replaces the content in its area, so it starts out as a copy
+   * of it. The area of each annotation is cleared and the page is rendered
+   * again with annotations there. */
+  cairo_t* cairo = cairo_create(layer);
+  cairo_set_operator(cairo, CAIRO_OPERATOR_SOURCE);
+  cairo_set_source_surface(cairo, content, 0, 0);
+  cairo_paint(cairo);
+  cairo_set_operator(cairo, CAIRO_OPERATOR_OVER);
+
+  cairo_set_matrix(cairo, matrix);
+  for (GList* link = annotations; link != NULL; link = g_list_next(link)) {
+    PopplerAnnotMapping* mapping = link->data;
+    cairo_rectangle(cairo, mapping->area.x1 - ANNOTATION_MARGIN,
+        page_height - mapping->area.y2 - ANNOTATION_MARGIN,
+        mapping->area.x2 - mapping->area.x1 + 2 * ANNOTATION_MARGIN,
+        mapping->area.y2 - mapping->area.y1 + 2 * ANNOTATION_MARGIN);
+  }
+  cairo_clip(cairo);
+
+  cairo_set_operator(cairo, CAIRO_OPERATOR_CLEAR);
+  cairo_paint(cairo);
+  cairo_set_operator(cairo, CAIRO_OPERATOR_OVER);
+  render_page(poppler_page, cairo, settings);
+  cairo_destroy(cairo);
+
+  return layer;
+}
+#endif
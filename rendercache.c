@@ -0,0 +1,524 @@
+/* See LICENSE file for license and copyright information */
+
+#include <string.h>
+#include <time.h>
+
+#include <glib/gstdio.h>
+#include <lz4.h>
+#include <girara/utils.h>
+
+#include "rendercache.h"
+#include "utils.h"
+
+#define RENDER_CACHE_MAGIC "ZPPR"
+#define RENDER_CACHE_VERSION 3
+/* Number of images waiting to be compressed. Further images are not cached,
+ * as pending images are held outside the memory budget. */
+#define RENDER_CACHE_PENDING_MAX 8
+/* Files on disk are only marked as used again after this many seconds */
+#define RENDER_CACHE_TOUCH_INTERVAL (60 * 60)
+
+/**
+ * Header of a compressed image. It is followed by the image data compressed
+ * as a single LZ4 block. Rendered pages are mostly runs of the same pixel and
+ * shrink to a fraction, and LZ4 decompresses them at memory speed, far below
+ * the cost of rendering the page again.
+ */
+typedef struct render_cache_header_s {
+  char magic[4]; /**< RENDER_CACHE_MAGIC */
+  guint32 version; /**< RENDER_CACHE_VERSION */
+  gint32 width; /**< Width of the image */
+  gint32 height; /**< Height of the image */
+  gint32 stride; /**< Stride of the image */
+  gint32 format; /**< cairo_format_t of the image */
+  gint32 encoding; /**< pdf_surface_encoding_t of the image */
+  guint32 reserved; /**< Padding */
+} render_cache_header_t;
+
+/**
+ * Everything a cached image depends on besides the document
+ */
+typedef struct render_cache_id_s {
+  guint32 index; /**< Index of the page */
+  guint32 profile; /**< Render profile */
+  gint32 width; /**< Width of the render target */
+  gint32 height; /**< Height of the render target */
+  cairo_matrix_t matrix; /**< Transformation of the render target */
+} render_cache_id_t;
+
+/**
+ * A compressed image in memory
+ */
+typedef struct render_cache_entry_s {
+  GList link; /**< Position in the list of entries */
+  char* key; /**< Key of the entry */
+  GBytes* data; /**< Header and compressed image */
+} render_cache_entry_t;
+
+typedef struct render_cache_s {
+  GMutex lock; /**< Lock for entries, lru and usage */
+  GHashTable* entries; /**< Entries by key */
+  GQueue lru; /**< Entries, most recently used first */
+  size_t usage; /**< Size of all entries */
+  size_t limit; /**< Size of the cache in memory, 0 if it is disabled */
+  goffset disk_limit; /**< Size of the cache on disk, 0 if it is disabled */
+  goffset disk_usage; /**< Size of the files on disk or -1 if not known yet,
+                        only used by the compressor */
+  GThreadPool* compressor; /**< Compresses images and writes them to disk */
+} render_cache_t;
+
+/**
+ * An image waiting to be compressed
+ */
+typedef struct render_cache_job_s {
+  char* key; /**< Key of the entry */
+  cairo_surface_t* surface; /**< The image */
+  pdf_surface_encoding_t encoding; /**< Encoding of the image */
+} render_cache_job_t;
+
+/**
+ * A file of the cache on disk
+ */
+typedef struct render_cache_file_s {
+  char* path; /**< Path of the file */
+  gint64 time; /**< Time the file was last used */
+  goffset size; /**< Size of the file */
+} render_cache_file_t;
+
+static render_cache_t* render_cache_get(void);
+static char* get_key(pdf_document_t* pdf_document, const render_cache_id_t* id);
+static char* get_directory(void);
+static void insert_locked(render_cache_t* render_cache, const char* key,
+    GBytes* data);
+static void entry_free(render_cache_entry_t* entry);
+static void compress_entry(gpointer data, gpointer user_data);
+static void write_entry(render_cache_t* render_cache, const char* key, GBytes*
+    data);
+static void prune_disk(render_cache_t* render_cache);
+static gint compare_files(gconstpointer a, gconstpointer b);
+static void file_free(gpointer data);
+
+bool
+pdf_render_cache_enabled(void)
+{
+  render_cache_t* render_cache = render_cache_get();
+
+  return render_cache->limit > 0 || render_cache->disk_limit > 0;
+}
+
+void
+pdf_render_cache_store(pdf_document_t* pdf_document, unsigned int index,
+    cairo_surface_t* surface, const cairo_matrix_t* matrix,
+    pdf_render_profile_t profile, pdf_surface_encoding_t encoding)
+{
+  render_cache_t* render_cache = render_cache_get();
+  if (pdf_render_cache_enabled() == false || surface == NULL ||
+      pdf_document->render_cache_key == NULL) {
+    return;
+  }
+
+  const render_cache_id_t id = {
+    .index   = index,
+    .profile = profile,
+    .width   = cairo_image_surface_get_width(surface),
+    .height  = cairo_image_surface_get_height(surface),
+    .matrix  = *matrix
+  };
+  char* key = get_key(pdf_document, &id);
+
+  g_mutex_lock(&render_cache->lock);
+  const bool cached = g_hash_table_contains(render_cache->entries, key) == TRUE;
+  g_mutex_unlock(&render_cache->lock);
+
+  if (cached == true ||
+      g_thread_pool_unprocessed(render_cache->compressor) >= RENDER_CACHE_PENDING_MAX) {
+    g_free(key);
+    return;
+  }
+
+  render_cache_job_t* job = g_malloc(sizeof(render_cache_job_t));
+  job->key      = key;
+  job->surface  = cairo_surface_reference(surface);
+  job->encoding = encoding;
+  g_thread_pool_push(render_cache->compressor, job, NULL);
+}
+
+cairo_surface_t*
+pdf_render_cache_load(pdf_document_t* pdf_document, unsigned int index, int
+    width, int height, const cairo_matrix_t* matrix, pdf_render_profile_t
+    profile, pdf_surface_encoding_t* encoding)
+{
+  render_cache_t* render_cache = render_cache_get();
+  if (pdf_render_cache_enabled() == false || pdf_document->render_cache_key == NULL) {
+    return NULL;
+  }
+
+  const render_cache_id_t id = {
+    .index   = index,
+    .profile = profile,
+    .width   = width,
+    .height  = height,
+    .matrix  = *matrix
+  };
+  char* key    = get_key(pdf_document, &id);
+  GBytes* data = NULL;
+
+  g_mutex_lock(&render_cache->lock);
+  render_cache_entry_t* entry = g_hash_table_lookup(render_cache->entries, key);
+  if (entry != NULL) {
+    g_queue_unlink(&render_cache->lru, &entry->link);
+    g_queue_push_head_link(&render_cache->lru, &entry->link);
+    data = g_bytes_ref(entry->data);
+  }
+  g_mutex_unlock(&render_cache->lock);
+
+  if (data == NULL && render_cache->disk_limit > 0) {
+    char* directory = get_directory();
+    char* path      = g_build_filename(directory, key, NULL);
+    char* contents  = NULL;
+    gsize length    = 0;
+
+    if (g_file_get_contents(path, &contents, &length, NULL) == TRUE) {
+      data = g_bytes_new_take(contents, length);
+
+      /* files are pruned by the time they were last used, which only needs
+       * to be roughly right */
+      GStatBuf buffer;
+      if (g_stat(path, &buffer) == 0 &&
+          time(NULL) - buffer.st_mtime > RENDER_CACHE_TOUCH_INTERVAL) {
+        g_utime(path, NULL);
+      }
+
+      g_mutex_lock(&render_cache->lock);
+      insert_locked(render_cache, key, data);
+      g_mutex_unlock(&render_cache->lock);
+    }
+    g_free(path);
+    g_free(directory);
+  }
+
+  g_free(key);
+
+  if (data == NULL) {
+    return NULL;
+  }
+
+  cairo_surface_t* surface = pdf_render_cache_decompress(data, encoding);
+  g_bytes_unref(data);
+
+  if (surface != NULL && (cairo_image_surface_get_width(surface) != width ||
+        cairo_image_surface_get_height(surface) != height)) {
+    cairo_surface_destroy(surface);
+    surface = NULL;
+  }
+
+  return surface;
+}
+
+GBytes*
+pdf_render_cache_compress(cairo_surface_t* surface, pdf_surface_encoding_t
+    encoding)
+{
+  cairo_surface_flush(surface);
+
+  const render_cache_header_t header = {
+    .magic    = RENDER_CACHE_MAGIC,
+    .version  = RENDER_CACHE_VERSION,
+    .width    = cairo_image_surface_get_width(surface),
+    .height   = cairo_image_surface_get_height(surface),
+    .stride   = cairo_image_surface_get_stride(surface),
+    .format   = cairo_image_surface_get_format(surface),
+    .encoding = encoding,
+    .reserved = 0
+  };
+
+  const guint8* input = cairo_image_surface_get_data(surface);
+  const gsize length  = (gsize) header.stride * header.height;
+  if (input == NULL || length > LZ4_MAX_INPUT_SIZE) {
+    return NULL;
+  }
+
+  const int bound = LZ4_compressBound(length);
+  guint8* output  = g_malloc(sizeof(header) + bound);
+  memcpy(output, &header, sizeof(header));
+
+  const int written = LZ4_compress_default((const char*) input, (char*) output +
+      sizeof(header), length, bound);
+  if (written <= 0) {
+    g_free(output);
+    return NULL;
+  }
+
+  const gsize size = sizeof(header) + written;
+  return g_bytes_new_take(g_realloc(output, size), size);
+}
+
+cairo_surface_t*
+pdf_render_cache_decompress(GBytes* data, pdf_surface_encoding_t* encoding)
+{
+  gsize size = 0;
+  const guchar* contents = g_bytes_get_data(data, &size);
+
+  render_cache_header_t header;
+  if (size < sizeof(header)) {
+    return NULL;
+  }
+  memcpy(&header, contents, sizeof(header));
+
+  if (memcmp(header.magic, RENDER_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != RENDER_CACHE_VERSION ||
+      (header.format != CAIRO_FORMAT_ARGB32 && header.format != CAIRO_FORMAT_A8 &&
+       header.format != CAIRO_FORMAT_A1) ||
+      header.encoding < PDF_SURFACE_COLOR || header.encoding > PDF_SURFACE_GRAY) {
+    return NULL;
+  }
+
+  cairo_surface_t* surface = cairo_image_surface_create(header.format,
+      header.width, header.height);
+  if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS ||
+      cairo_image_surface_get_stride(surface) != header.stride) {
+    cairo_surface_destroy(surface);
+    return NULL;
+  }
+
+  cairo_surface_flush(surface);
+
+  /* the image is decompressed right into the surface, it has to fill it
+   * exactly */
+  guint8* output            = cairo_image_surface_get_data(surface);
+  const gsize output_length = (gsize) header.stride * header.height;
+  const gsize input_length  = size - sizeof(header);
+  if (output == NULL || output_length > LZ4_MAX_INPUT_SIZE ||
+      input_length > G_MAXINT) {
+    cairo_surface_destroy(surface);
+    return NULL;
+  }
+
+  const int written = LZ4_decompress_safe((const char*) contents + sizeof(header),
+      (char*) output, input_length, output_length);
+  if (written < 0 || (gsize) written != output_length) {
+    cairo_surface_destroy(surface);
+    return NULL;
+  }
+
+  cairo_surface_mark_dirty(surface);
+  *encoding = header.encoding;
+
+  return surface;
+}
+
+static render_cache_t*
+render_cache_get(void)
+{
+  static render_cache_t* render_cache = NULL;
+
+  if (g_once_init_enter(&render_cache)) {
+    render_cache_t* new_render_cache = g_malloc0(sizeof(render_cache_t));
+    g_mutex_init(&new_render_cache->lock);
+    g_queue_init(&new_render_cache->lru);
+    new_render_cache->entries    = g_hash_table_new(g_str_hash, g_str_equal);
+    new_render_cache->disk_usage = -1;
+
+    const char* value = g_getenv(PDF_RENDER_CACHE_OPTION);
+    if (value != NULL && *value != '\0') {
+      new_render_cache->limit = g_ascii_strtoull(value, NULL, 10) * 1024 * 1024;
+    }
+
+    value = g_getenv(PDF_RENDER_CACHE_DISK_OPTION);
+    if (value != NULL && *value != '\0') {
+      new_render_cache->disk_limit = g_ascii_strtoull(value, NULL, 10) * 1024 * 1024;
+    }
+
+    /* a single thread keeps compression from competing with rendering and
+     * the disk from being hammered while reading */
+    if (new_render_cache->limit > 0 || new_render_cache->disk_limit > 0) {
+      new_render_cache->compressor = g_thread_pool_new(compress_entry,
+          new_render_cache, 1, FALSE, NULL);
+    }
+
+    g_once_init_leave(&render_cache, (gsize) new_render_cache);
+  }
+
+  return render_cache;
+}
+
+static char*
+get_key(pdf_document_t* pdf_document, const render_cache_id_t* id)
+{
+  GChecksum* checksum = g_checksum_new(G_CHECKSUM_SHA1);
+  g_checksum_update(checksum, (const guchar*) id, sizeof(render_cache_id_t));
+
+  char* key = g_strdup_printf("%s-%s", pdf_document->render_cache_key,
+      g_checksum_get_string(checksum));
+  g_checksum_free(checksum);
+
+  return key;
+}
+
+static char*
+get_directory(void)
+{
+  return g_build_filename(g_get_user_cache_dir(), "zathura-pdf-poppler",
+      "render", NULL);
+}
+
+static void
+insert_locked(render_cache_t* render_cache, const char* key, GBytes* data)
+{
+  const size_t size = g_bytes_get_size(data);
+  if (size > render_cache->limit ||
+      g_hash_table_contains(render_cache->entries, key) == TRUE) {
+    return;
+  }
+
+  render_cache_entry_t* entry = g_malloc0(sizeof(render_cache_entry_t));
+  entry->key        = g_strdup(key);
+  entry->data       = g_bytes_ref(data);
+  entry->link.data  = entry;
+
+  g_hash_table_insert(render_cache->entries, entry->key, entry);
+  g_queue_push_head_link(&render_cache->lru, &entry->link);
+  render_cache->usage += size;
+
+  while (render_cache->usage > render_cache->limit) {
+    GList* link = g_queue_pop_tail_link(&render_cache->lru);
+    render_cache_entry_t* last = link->data;
+
+    g_hash_table_remove(render_cache->entries, last->key);
+    render_cache->usage -= g_bytes_get_size(last->data);
+    entry_free(last);
+  }
+}
+
+static void
+entry_free(render_cache_entry_t* entry)
+{
+  g_bytes_unref(entry->data);
+  g_free(entry->key);
+  g_free(entry);
+}
+
+static void
+compress_entry(gpointer data, gpointer user_data)
+{
+  render_cache_job_t* job      = data;
+  render_cache_t* render_cache = user_data;
+
+  GBytes* compressed = pdf_render_cache_compress(job->surface, job->encoding);
+  cairo_surface_destroy(job->surface);
+
+  if (compressed != NULL) {
+    g_mutex_lock(&render_cache->lock);
+    insert_locked(render_cache, job->key, compressed);
+    g_mutex_unlock(&render_cache->lock);
+
+    if (render_cache->disk_limit > 0) {
+      write_entry(render_cache, job->key, compressed);
+    }
+
+    g_bytes_unref(compressed);
+  }
+
+  g_free(job->key);
+  g_free(job);
+}
+
+static void
+write_entry(render_cache_t* render_cache, const char* key, GBytes* data)
+{
+  char* directory = get_directory();
+  char* path      = g_build_filename(directory, key, NULL);
+
+  gsize length = 0;
+  const char* contents = g_bytes_get_data(data, &length);
+
+  if (g_file_test(path, G_FILE_TEST_EXISTS) == FALSE && (goffset) length <=
+      render_cache->disk_limit) {
+    if (g_mkdir_with_parents(directory, 0700) != 0) {
+      girara_warning("Failed to create cache directory %s", directory);
+    } else if (g_file_set_contents(path, contents, length, NULL) == TRUE) {
+      /* the directory is only scanned when it is pruned, files written by
+       * other instances are noticed then */
+      if (render_cache->disk_usage >= 0) {
+        render_cache->disk_usage += length;
+      }
+      if (render_cache->disk_usage < 0 ||
+          render_cache->disk_usage > render_cache->disk_limit) {
+        prune_disk(render_cache);
+      }
+    }
+  }
+
+  g_free(path);
+  g_free(directory);
+}
+
+static void
+prune_disk(render_cache_t* render_cache)
+{
+  char* directory = get_directory();
+  GDir* dir       = g_dir_open(directory, 0, NULL);
+  if (dir == NULL) {
+    g_free(directory);
+    return;
+  }
+
+  GPtrArray* files = g_ptr_array_new_with_free_func(file_free);
+  goffset usage    = 0;
+
+  const char* name = NULL;
+  while ((name = g_dir_read_name(dir)) != NULL) {
+    char* path = g_build_filename(directory, name, NULL);
+
+    GStatBuf buffer;
+    if (g_stat(path, &buffer) != 0 || S_ISREG(buffer.st_mode) == 0) {
+      g_free(path);
+      continue;
+    }
+
+    render_cache_file_t* file = g_malloc(sizeof(render_cache_file_t));
+    file->path = path;
+    file->time = buffer.st_mtime;
+    file->size = buffer.st_size;
+    g_ptr_array_add(files, file);
+    usage += file->size;
+  }
+  g_dir_close(dir);
+
+  /* least recently used files go first, down to three quarters of the limit
+   * so that not every write prunes again */
+  if (usage > render_cache->disk_limit) {
+    const goffset target = render_cache->disk_limit - render_cache->disk_limit / 4;
+
+    g_ptr_array_sort(files, compare_files);
+    for (guint i = 0; i < files->len && usage > target; i++) {
+      render_cache_file_t* file = g_ptr_array_index(files, i);
+      if (g_remove(file->path) == 0) {
+        usage -= file->size;
+      }
+    }
+  }
+
+  render_cache->disk_usage = usage;
+
+  g_ptr_array_unref(files);
+  g_free(directory);
+}
+
+static gint
+compare_files(gconstpointer a, gconstpointer b)
+{
+  const render_cache_file_t* file_a = *(render_cache_file_t* const*) a;
+  const render_cache_file_t* file_b = *(render_cache_file_t* const*) b;
+
+  return (file_a->time > file_b->time) - (file_a->time < file_b->time);
+}
+
+static void
+file_free(gpointer data)
+{
+  render_cache_file_t* file = data;
+
+  g_free(file->path);
+  g_free(file);
+}
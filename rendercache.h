@@ -0,0 +1,81 @@
+/* See LICENSE file for license and copyright information */
+
+#ifndef RENDERCACHE_H
+#define RENDERCACHE_H
+
+#include "plugin.h"
+
+/**
+ * Name of the environment variable that sets the size of the compressed
+ * render cache in MiB
+ */
+#define PDF_RENDER_CACHE_OPTION "ZATHURA_PDF_POPPLER_RENDER_CACHE"
+
+/**
+ * Name of the environment variable that sets the size of the compressed
+ * render cache on disk in MiB
+ */
+#define PDF_RENDER_CACHE_DISK_OPTION "ZATHURA_PDF_POPPLER_RENDER_CACHE_DISK"
+
+/**
+ * Checks if rendered pages are kept in the compressed render cache
+ *
+ * @return true if the cache is enabled in memory or on disk
+ */
+bool pdf_render_cache_enabled(void);
+
+/**
+ * Adds the rendered image of a page to the render cache. The image is
+ * compressed on a background thread; if too many images are waiting for it
+ * already, the image is not cached.
+ *
+ * @param pdf_document The document
+ * @param index Index of the page
+ * @param surface The image, it must not be changed afterwards
+ * @param matrix Transformation the image was rendered with
+ * @param profile Profile the image was rendered with
+ * @param encoding Encoding of the image
+ */
+void pdf_render_cache_store(pdf_document_t* pdf_document, unsigned int index,
+    cairo_surface_t* surface, const cairo_matrix_t* matrix,
+    pdf_render_profile_t profile, pdf_surface_encoding_t encoding);
+
+/**
+ * Looks up a rendered image of a page in the render cache
+ *
+ * @param pdf_document The document
+ * @param index Index of the page
+ * @param width Width of the render target
+ * @param height Height of the render target
+ * @param matrix Transformation of the render target
+ * @param profile The render profile
+ * @param encoding Set to the encoding of the image
+ * @return The image (needs to be released with cairo_surface_destroy) or NULL
+ *   if the page is not cached
+ */
+cairo_surface_t* pdf_render_cache_load(pdf_document_t* pdf_document,
+    unsigned int index, int width, int height, const cairo_matrix_t* matrix,
+    pdf_render_profile_t profile, pdf_surface_encoding_t* encoding);
+
+/**
+ * Compresses an image the way it is kept in the render cache
+ *
+ * @param surface The image
+ * @param encoding Encoding of the image
+ * @return Header and compressed image or NULL if an error occurred
+ */
+GBytes* pdf_render_cache_compress(cairo_surface_t* surface,
+    pdf_surface_encoding_t encoding);
+
+/**
+ * Decompresses an image compressed with pdf_render_cache_compress
+ *
+ * @param data Header and compressed image
+ * @param encoding Set to the encoding of the image
+ * @return The image (needs to be released with cairo_surface_destroy) or NULL
+ *   if the data is invalid
+ */
+cairo_surface_t* pdf_render_cache_decompress(GBytes* data,
+    pdf_surface_encoding_t* encoding);
+
+#endif // RENDERCACHE_H
@@ -2,19 +2,126 @@
 
 #include <string.h>
 
+#include <girara/utils.h>
+
 #include "plugin.h"
+#include "pagecache.h"
+
+/**
+ * Search modifiers. They are given as a sequence of backslash escapes in
+ * front of the search term, e.g. "\r\Cfoo[0-9]+" searches case sensitive
+ * for the regular expression "foo[0-9]+".
+ */
+typedef enum pdf_search_flags_e {
+  PDF_SEARCH_DEFAULT            = 0,
+  PDF_SEARCH_REGEX              = 1 << 0, /**< \r: regular expression */
+  PDF_SEARCH_CASE_SENSITIVE     = 1 << 1, /**< \C: case sensitive */
+  PDF_SEARCH_IGNORE_DIACRITICS  = 1 << 2, /**< \a: ignore accents and other marks */
+  PDF_SEARCH_WHOLE_WORDS        = 1 << 3  /**< \w: only match whole words */
+} pdf_search_flags_t;
+
+/**
+ * A compiled search query
+ */
+typedef struct pdf_search_query_s {
+  gint ref_count; /**< Reference count */
+  char* text; /**< Query as entered by the user */
+  pdf_search_flags_t flags; /**< Search modifiers */
+  GRegex* regex; /**< Compiled expression or NULL if it is invalid */
+} pdf_search_query_t;
+
+/**
+ * Normalized page text
+ */
+typedef struct pdf_search_text_s {
+  GString* haystack; /**< Text the expression is matched against */
+  GArray* offsets; /**< Byte offset in haystack -> character index in page text */
+  GArray* characters; /**< Character index in page text -> unicode character */
+} pdf_search_text_t;
+
+static girara_list_t* search_with_poppler(zathura_page_t* page, PopplerPage*
+    poppler_page, const char* text, zathura_error_t* error);
+static girara_list_t* search_with_query(pdf_page_t* pdf_page, PopplerPage*
+    poppler_page, pdf_search_query_t* query, zathura_error_t* error);
+static const char* parse_modifiers(const char* text, pdf_search_flags_t* flags);
+static pdf_search_query_t* search_query_get(const char* text);
+static void search_query_unref(pdf_search_query_t* query);
+static void search_text_build(pdf_search_text_t* search_text, const char*
+    text, bool ignore_diacritics);
+static void search_text_clear(pdf_search_text_t* search_text);
+static bool is_word_boundary(pdf_search_text_t* search_text, gint offset, bool before);
+static void append_rectangles(girara_list_t* list, pdf_search_text_t*
+    search_text, PopplerRectangle* rectangles, guint n_rectangles, guint first,
+    guint last);
+
+/* The last compiled query is kept around so that searching through a document
+ * compiles the expression only once and not once per page. */
+static GMutex query_cache_lock;
+static pdf_search_query_t* query_cache = NULL;
 
 girara_list_t*
-pdf_page_search_text(zathura_page_t* page, PopplerPage* poppler_page, const
+pdf_page_search_text(zathura_page_t* page, pdf_page_t* pdf_page, const
     char* text, zathura_error_t* error)
 {
-  if (page == NULL || poppler_page == NULL || text == NULL || strlen(text) == 0) {
+  if (page == NULL || pdf_page == NULL || text == NULL || strlen(text) == 0) {
+    if (error != NULL) {
+      *error = ZATHURA_ERROR_INVALID_ARGUMENTS;
+    }
+    return NULL;
+  }
+
+  pdf_search_flags_t flags = PDF_SEARCH_DEFAULT;
+  const char* term = parse_modifiers(text, &flags);
+  if (strlen(term) == 0) {
     if (error != NULL) {
       *error = ZATHURA_ERROR_INVALID_ARGUMENTS;
     }
-    goto error_ret;
+    return NULL;
+  }
+
+  /* plain search terms keep using poppler's own search */
+  pdf_search_query_t* query = NULL;
+  if (term != text) {
+    query = search_query_get(text);
+    if (query->regex == NULL) {
+      search_query_unref(query);
+      if (error != NULL) {
+        *error = ZATHURA_ERROR_INVALID_ARGUMENTS;
+      }
+      return NULL;
+    }
   }
 
+  PopplerPage* poppler_page = pdf_page_get_poppler_page(pdf_page);
+  if (poppler_page == NULL) {
+    if (query != NULL) {
+      search_query_unref(query);
+    }
+    if (error != NULL) {
+      *error = ZATHURA_ERROR_UNKNOWN;
+    }
+    return NULL;
+  }
+
+  /* searches with a query account the text through the page cache */
+  girara_list_t* list = NULL;
+  if (query == NULL) {
+    list = search_with_poppler(page, poppler_page, text, error);
+    pdf_page_set_text_loaded(pdf_page, poppler_page, -1);
+  } else {
+    list = search_with_query(pdf_page, poppler_page, query, error);
+    search_query_unref(query);
+  }
+
+  g_object_unref(poppler_page);
+
+  return list;
+}
+
+static girara_list_t*
+search_with_poppler(zathura_page_t* page, PopplerPage* poppler_page, const
+    char* text, zathura_error_t* error)
+{
   GList* results      = NULL;
   girara_list_t* list = NULL;
 
@@ -62,7 +169,292 @@ error_free:
     girara_list_free(list);
   }
 
-error_ret:
+  return NULL;
+}
+
+static girara_list_t*
+search_with_query(pdf_page_t* pdf_page, PopplerPage* poppler_page,
+    pdf_search_query_t* query, zathura_error_t* error)
+{
+  girara_list_t* list          = NULL;
+  char* text                   = NULL;
+  PopplerRectangle* rectangles = NULL;
+  guint n_rectangles           = 0;
+  GMatchInfo* match_info       = NULL;
+
+  pdf_search_text_t search_text = { NULL, NULL, NULL };
+
+  if (pdf_page_cache_get_text(pdf_page, poppler_page, &text, &rectangles,
+        &n_rectangles) == false) {
+    if (error != NULL) {
+      *error = ZATHURA_ERROR_UNKNOWN;
+    }
+    goto error_free;
+  }
+
+  search_text_build(&search_text, text,
+      (query->flags & PDF_SEARCH_IGNORE_DIACRITICS) != 0);
+
+  list = girara_list_new2(g_free);
+  if (list == NULL) {
+    if (error != NULL) {
+      *error = ZATHURA_ERROR_OUT_OF_MEMORY;
+    }
+    goto error_free;
+  }
+
+  g_regex_match(query->regex, search_text.haystack->str, 0, &match_info);
+  while (g_match_info_matches(match_info) == TRUE) {
+    gint start = 0;
+    gint end   = 0;
+
+    if (g_match_info_fetch_pos(match_info, 0, &start, &end) == TRUE && end > start) {
+      if ((query->flags & PDF_SEARCH_WHOLE_WORDS) == 0 ||
+          (is_word_boundary(&search_text, start, true) == true &&
+           is_word_boundary(&search_text, end, false) == true)) {
+        const guint first = g_array_index(search_text.offsets, guint, start);
+        const guint last  = g_array_index(search_text.offsets, guint, end - 1);
+        append_rectangles(list, &search_text, rectangles, n_rectangles, first, last);
+      }
+    }
+
+    g_match_info_next(match_info, NULL);
+  }
+  g_match_info_free(match_info);
+
+  if (girara_list_size(list) == 0) {
+    if (error != NULL) {
+      *error = ZATHURA_ERROR_UNKNOWN;
+    }
+    goto error_free;
+  }
+
+  search_text_clear(&search_text);
+  g_free(rectangles);
+  g_free(text);
+
+  return list;
+
+error_free:
+
+  search_text_clear(&search_text);
+
+  if (list != NULL) {
+    girara_list_free(list);
+  }
+
+  g_free(rectangles);
+  g_free(text);
 
   return NULL;
 }
+
+static const char*
+parse_modifiers(const char* text, pdf_search_flags_t* flags)
+{
+  while (text[0] == '\\' && text[1] != '\0') {
+    switch (text[1]) {
+      case 'r':
+        *flags |= PDF_SEARCH_REGEX;
+        break;
+      case 'C':
+        *flags |= PDF_SEARCH_CASE_SENSITIVE;
+        break;
+      case 'a':
+        *flags |= PDF_SEARCH_IGNORE_DIACRITICS;
+        break;
+      case 'w':
+        *flags |= PDF_SEARCH_WHOLE_WORDS;
+        break;
+      default:
+        return text;
+    }
+    text += 2;
+  }
+
+  return text;
+}
+
+static pdf_search_query_t*
+search_query_get(const char* text)
+{
+  g_mutex_lock(&query_cache_lock);
+
+  if (query_cache != NULL && g_strcmp0(query_cache->text, text) == 0) {
+    g_atomic_int_inc(&query_cache->ref_count);
+    pdf_search_query_t* query = query_cache;
+    g_mutex_unlock(&query_cache_lock);
+    return query;
+  }
+
+  pdf_search_query_t* query = g_malloc0(sizeof(pdf_search_query_t));
+  query->ref_count = 1;
+  query->text      = g_strdup(text);
+
+  const char* term = parse_modifiers(text, &query->flags);
+
+  /* terms are normalized like the text they are matched against; dropping
+   * marks from an expression only changes its literals and character
+   * classes, since its syntax is plain ASCII */
+  char* normalized = NULL;
+  if ((query->flags & PDF_SEARCH_IGNORE_DIACRITICS) != 0) {
+    pdf_search_text_t search_text = { NULL, NULL, NULL };
+    search_text_build(&search_text, term, true);
+    normalized = g_strdup(search_text.haystack->str);
+    search_text_clear(&search_text);
+    term = normalized;
+  }
+
+  /* plain terms are matched literally */
+  char* pattern = NULL;
+  if ((query->flags & PDF_SEARCH_REGEX) != 0) {
+    pattern = g_strdup(term);
+  } else {
+    pattern = g_regex_escape_string(term, -1);
+  }
+
+  GRegexCompileFlags compile_flags = G_REGEX_OPTIMIZE;
+  if ((query->flags & PDF_SEARCH_CASE_SENSITIVE) == 0) {
+    compile_flags |= G_REGEX_CASELESS;
+  }
+
+  GError* gerror = NULL;
+  query->regex = g_regex_new(pattern, compile_flags, 0, &gerror);
+  if (query->regex == NULL) {
+    girara_warning("Invalid search expression '%s': %s", text,
+        gerror != NULL ? gerror->message : "unknown error");
+    if (gerror != NULL) {
+      g_error_free(gerror);
+    }
+  }
+  g_free(pattern);
+  g_free(normalized);
+
+  if (query_cache != NULL) {
+    search_query_unref(query_cache);
+  }
+  query_cache = query;
+  g_atomic_int_inc(&query->ref_count);
+
+  g_mutex_unlock(&query_cache_lock);
+
+  return query;
+}
+
+static void
+search_query_unref(pdf_search_query_t* query)
+{
+  if (g_atomic_int_dec_and_test(&query->ref_count) == FALSE) {
+    return;
+  }
+
+  if (query->regex != NULL) {
+    g_regex_unref(query->regex);
+  }
+
+  g_free(query->text);
+  g_free(query);
+}
+
+static void
+search_text_build(pdf_search_text_t* search_text, const char* text, bool
+    ignore_diacritics)
+{
+  search_text->haystack   = g_string_sized_new(strlen(text));
+  search_text->offsets    = g_array_sized_new(FALSE, FALSE, sizeof(guint), strlen(text));
+  search_text->characters = g_array_new(FALSE, FALSE, sizeof(gunichar));
+
+  guint index = 0;
+  for (const char* p = text; *p != '\0'; p = g_utf8_next_char(p), index++) {
+    gunichar character = g_utf8_get_char(p);
+    g_array_append_val(search_text->characters, character);
+
+    /* lines are joined so that terms can span line breaks */
+    if (character == '\n') {
+      character = ' ';
+    }
+
+    gunichar decomposition[G_UNICHAR_MAX_DECOMPOSITION_LENGTH];
+    gsize length = 1;
+    if (ignore_diacritics == true) {
+      length = g_unichar_fully_decompose(character, FALSE, decomposition,
+          G_UNICHAR_MAX_DECOMPOSITION_LENGTH);
+    } else {
+      decomposition[0] = character;
+    }
+
+    for (gsize i = 0; i < length; i++) {
+      if (ignore_diacritics == true && g_unichar_ismark(decomposition[i]) == TRUE) {
+        continue;
+      }
+
+      const gsize before = search_text->haystack->len;
+      g_string_append_unichar(search_text->haystack, decomposition[i]);
+      for (gsize j = before; j < search_text->haystack->len; j++) {
+        g_array_append_val(search_text->offsets, index);
+      }
+    }
+  }
+}
+
+static void
+search_text_clear(pdf_search_text_t* search_text)
+{
+  if (search_text->haystack != NULL) {
+    g_string_free(search_text->haystack, TRUE);
+  }
+
+  if (search_text->offsets != NULL) {
+    g_array_free(search_text->offsets, TRUE);
+  }
+
+  if (search_text->characters != NULL) {
+    g_array_free(search_text->characters, TRUE);
+  }
+}
+
+static bool
+is_word_boundary(pdf_search_text_t* search_text, gint offset, bool before)
+{
+  if ((before == true && offset == 0) ||
+      (before == false && (gsize) offset >= search_text->haystack->len)) {
+    return true;
+  }
+
+  /* look at the original character next to the match */
+  guint index = g_array_index(search_text->offsets, guint, before == true ? offset - 1 : offset);
+  gunichar character = g_array_index(search_text->characters, gunichar, index);
+
+  return g_unichar_isalnum(character) == FALSE;
+}
+
+static void
+append_rectangles(girara_list_t* list, pdf_search_text_t* search_text,
+    PopplerRectangle* rectangles, guint n_rectangles, guint first, guint last)
+{
+  zathura_rectangle_t* rectangle = NULL;
+
+  /* one rectangle per line the match spans */
+  for (guint i = first; i <= last && i < n_rectangles; i++) {
+    if (g_array_index(search_text->characters, gunichar, i) == '\n') {
+      rectangle = NULL;
+      continue;
+    }
+
+    const PopplerRectangle* glyph = &rectangles[i];
+    if (rectangle == NULL) {
+      rectangle = g_malloc0(sizeof(zathura_rectangle_t));
+      rectangle->x1 = glyph->x1;
+      rectangle->x2 = glyph->x2;
+      rectangle->y1 = glyph->y1;
+      rectangle->y2 = glyph->y2;
+      girara_list_append(list, rectangle);
+      continue;
+    }
+
+    rectangle->x1 = MIN(rectangle->x1, glyph->x1);
+    rectangle->x2 = MAX(rectangle->x2, glyph->x2);
+    rectangle->y1 = MIN(rectangle->y1, glyph->y1);
+    rectangle->y2 = MAX(rectangle->y2, glyph->y2);
+  }
+}
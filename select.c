@@ -3,16 +3,24 @@
 #include "plugin.h"
 
 char*
-pdf_page_get_text(zathura_page_t* page, PopplerPage* poppler_page,
+pdf_page_get_text(zathura_page_t* page, pdf_page_t* pdf_page,
     zathura_rectangle_t rectangle, zathura_error_t* error)
 {
-  if (page == NULL || poppler_page == NULL) {
+  if (page == NULL || pdf_page == NULL) {
     if (error != NULL) {
       *error = ZATHURA_ERROR_INVALID_ARGUMENTS;
     }
     return NULL;
   }
 
+  PopplerPage* poppler_page = pdf_page_get_poppler_page(pdf_page);
+  if (poppler_page == NULL) {
+    if (error != NULL) {
+      *error = ZATHURA_ERROR_UNKNOWN;
+    }
+    return NULL;
+  }
+
   PopplerRectangle rect = {
     .x1 = rectangle.x1,
     .x2 = rectangle.x2,
@@ -21,5 +29,9 @@ pdf_page_get_text(zathura_page_t* page, PopplerPage* poppler_page,
   };
 
   /* get selected text */
-  return poppler_page_get_selected_text(poppler_page, POPPLER_SELECTION_GLYPH, &rect);
+  char* text = poppler_page_get_selected_text(poppler_page, POPPLER_SELECTION_GLYPH, &rect);
+  pdf_page_set_text_loaded(pdf_page, poppler_page, -1);
+  g_object_unref(poppler_page);
+
+  return text;
 }
@@ -0,0 +1,178 @@
+/* See LICENSE file for license and copyright information */
+
+#include "task.h"
+
+/* minimum time between two progress reports in microseconds */
+#define TASK_PROGRESS_INTERVAL 100000
+
+/**
+ * Data attached to the task of an asynchronous operation
+ */
+typedef struct task_data_s {
+  void* object; /**< Object the operation works on */
+  GDestroyNotify object_free; /**< Function to free object or NULL */
+  pdf_progress_t progress; /**< Progress callback or NULL */
+  void* progress_data; /**< Custom data passed to progress */
+  gint64 last_progress; /**< Time of the last report (only used by the worker) */
+  bool finished; /**< Set once the result has been taken */
+} task_data_t;
+
+/**
+ * Progress report on its way to the main context
+ */
+typedef struct task_progress_s {
+  GTask* task; /**< The task */
+  unsigned int done; /**< Units of work done */
+  unsigned int total; /**< Total units of work or 0 */
+} task_progress_t;
+
+static GQuark task_error_quark(void);
+static gboolean report_progress(gpointer data);
+static void progress_free(gpointer data);
+static void task_data_free(gpointer data);
+
+GTask*
+pdf_task_new(void* object, GDestroyNotify object_free, bool return_on_cancel,
+    GCancellable* cancellable, pdf_progress_t progress, void* progress_data,
+    GAsyncReadyCallback callback, void* data)
+{
+  task_data_t* task_data   = g_malloc0(sizeof(task_data_t));
+  task_data->object        = object;
+  task_data->object_free   = object_free;
+  task_data->progress      = progress;
+  task_data->progress_data = progress_data;
+
+  GTask* task = g_task_new(NULL, cancellable, callback, data);
+  g_task_set_task_data(task, task_data, task_data_free);
+  g_task_set_return_on_cancel(task, return_on_cancel);
+
+  return task;
+}
+
+void*
+pdf_task_get_object(GTask* task)
+{
+  task_data_t* task_data = g_task_get_task_data(task);
+
+  return task_data->object;
+}
+
+bool
+pdf_task_cancelled(GTask* task)
+{
+  return task != NULL && g_cancellable_is_cancelled(g_task_get_cancellable(task)) == TRUE;
+}
+
+void
+pdf_task_progress(GTask* task, unsigned int done, unsigned int total)
+{
+  if (task == NULL) {
+    return;
+  }
+
+  task_data_t* task_data = g_task_get_task_data(task);
+  if (task_data->progress == NULL) {
+    return;
+  }
+
+  const gint64 now = g_get_monotonic_time();
+  if (done != total && now - task_data->last_progress < TASK_PROGRESS_INTERVAL) {
+    return;
+  }
+  task_data->last_progress = now;
+
+  task_progress_t* report = g_malloc(sizeof(task_progress_t));
+  report->task  = g_object_ref(task);
+  report->done  = done;
+  report->total = total;
+
+  g_main_context_invoke_full(g_task_get_context(task), G_PRIORITY_DEFAULT,
+      report_progress, report, progress_free);
+}
+
+void
+pdf_task_return(GTask* task, void* result, GDestroyNotify result_free)
+{
+  /* the callback has already been invoked if the operation was cancelled */
+  if (g_task_set_return_on_cancel(task, FALSE) == FALSE) {
+    if (result_free != NULL) {
+      result_free(result);
+    }
+    return;
+  }
+
+  g_task_return_pointer(task, result, result_free);
+}
+
+void
+pdf_task_return_error(GTask* task, zathura_error_t error)
+{
+  if (g_task_set_return_on_cancel(task, FALSE) == FALSE) {
+    return;
+  }
+
+  g_task_return_new_error(task, task_error_quark(), error, "Operation failed");
+}
+
+void*
+pdf_task_finish(GAsyncResult* result, zathura_error_t* error)
+{
+  GTask* task = G_TASK(result);
+
+  task_data_t* task_data = g_task_get_task_data(task);
+  task_data->finished    = true;
+
+  GError* gerror = NULL;
+  void* value    = g_task_propagate_pointer(task, &gerror);
+
+  if (gerror != NULL) {
+    if (error != NULL) {
+      /* cancelled operations fail with an error of gio */
+      *error = gerror->domain == task_error_quark() ? (zathura_error_t)
+        gerror->code : ZATHURA_ERROR_UNKNOWN;
+    }
+    g_error_free(gerror);
+  }
+
+  return value;
+}
+
+static GQuark
+task_error_quark(void)
+{
+  return g_quark_from_static_string("zathura-pdf-poppler-task-error");
+}
+
+static gboolean
+report_progress(gpointer data)
+{
+  task_progress_t* report = data;
+  task_data_t* task_data  = g_task_get_task_data(report->task);
+
+  if (task_data->finished == false && pdf_task_cancelled(report->task) == false) {
+    task_data->progress(report->done, report->total, task_data->progress_data);
+  }
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+progress_free(gpointer data)
+{
+  task_progress_t* report = data;
+
+  g_object_unref(report->task);
+  g_free(report);
+}
+
+static void
+task_data_free(gpointer data)
+{
+  task_data_t* task_data = data;
+
+  if (task_data->object_free != NULL) {
+    task_data->object_free(task_data->object);
+  }
+
+  g_free(task_data);
+}
@@ -0,0 +1,80 @@
+/* See LICENSE file for license and copyright information */
+
+#ifndef TASK_H
+#define TASK_H
+
+#include "plugin.h"
+
+/**
+ * Creates the task of an asynchronous operation. The callback is invoked in
+ * the thread-default main context of the calling thread.
+ *
+ * @param object Object the operation works on
+ * @param object_free Function to free object with the task or NULL
+ * @param return_on_cancel Set to invoke the callback as soon as the operation
+ *   is cancelled, even if the worker is still busy
+ * @param cancellable Cancellable or NULL
+ * @param progress Progress callback or NULL
+ * @param progress_data Custom data passed to progress
+ * @param callback Callback invoked when the operation is done
+ * @param data Custom data passed to callback
+ * @return The task
+ */
+GTask* pdf_task_new(void* object, GDestroyNotify object_free, bool
+    return_on_cancel, GCancellable* cancellable, pdf_progress_t progress,
+    void* progress_data, GAsyncReadyCallback callback, void* data);
+
+/**
+ * Returns the object the operation works on
+ *
+ * @param task The task
+ * @return The object
+ */
+void* pdf_task_get_object(GTask* task);
+
+/**
+ * Checks if the operation has been cancelled
+ *
+ * @param task The task or NULL
+ * @return true if the operation has been cancelled
+ */
+bool pdf_task_cancelled(GTask* task);
+
+/**
+ * Reports progress from the worker. Reports are passed on to the main context
+ * of the task at a limited rate, the last one is always passed on.
+ *
+ * @param task The task or NULL
+ * @param done Units of work done so far
+ * @param total Total units of work or 0 if it is not known
+ */
+void pdf_task_progress(GTask* task, unsigned int done, unsigned int total);
+
+/**
+ * Returns the result of the operation from the worker
+ *
+ * @param task The task
+ * @param result The result
+ * @param result_free Function to free result if nobody takes it
+ */
+void pdf_task_return(GTask* task, void* result, GDestroyNotify result_free);
+
+/**
+ * Returns an error from the worker
+ *
+ * @param task The task
+ * @param error The error
+ */
+void pdf_task_return_error(GTask* task, zathura_error_t error);
+
+/**
+ * Takes the result of an operation. No progress is reported afterwards.
+ *
+ * @param result The result passed to the callback
+ * @param error Set to an error value (see zathura_error_t) if an error
+ *   occurred or the operation has been cancelled
+ * @return The result or NULL if an error occurred
+ */
+void* pdf_task_finish(GAsyncResult* result, zathura_error_t* error);
+
+#endif // TASK_H
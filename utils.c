@@ -1,5 +1,10 @@
 /* See LICENSE file for license and copyright information */
 
+#include <string.h>
+
+#include <glib/gstdio.h>
+#include <girara/utils.h>
+
 #include "utils.h"
 
 zathura_link_t*
@@ -126,3 +131,87 @@ poppler_link_to_zathura_link(PopplerDocument* poppler_document, PopplerAction*
 
   return zathura_link_new(type, position, target);
 }
+
+bool
+pdf_option_enabled(const char* name)
+{
+  const char* value = g_getenv(name);
+
+  return value != NULL && *value != '\0' && g_strcmp0(value, "0") != 0;
+}
+
+bool
+pdf_get_document_id(PopplerDocument* poppler_document, guint8
+    id[PDF_DOCUMENT_ID_LENGTH])
+{
+  gchar* permanent_id = NULL;
+  gchar* update_id    = NULL;
+
+  if (poppler_document_get_id(poppler_document, &permanent_id, &update_id) == FALSE) {
+    return false;
+  }
+
+  /* both IDs are 32 bytes long and not terminated */
+  memcpy(id, permanent_id, PDF_DOCUMENT_ID_LENGTH / 2);
+  memcpy(id + PDF_DOCUMENT_ID_LENGTH / 2, update_id, PDF_DOCUMENT_ID_LENGTH / 2);
+  g_free(permanent_id);
+  g_free(update_id);
+
+  return true;
+}
+
+bool
+pdf_get_file_state(const char* path, gint64* mtime, gint64* size)
+{
+  GStatBuf buffer;
+  if (path == NULL || g_stat(path, &buffer) != 0) {
+    return false;
+  }
+
+  *mtime = buffer.st_mtime;
+  *size  = buffer.st_size;
+
+  return true;
+}
+
+PopplerDocument*
+pdf_open_poppler_document_copy(pdf_document_t* pdf_document)
+{
+  zathura_document_t* document = pdf_document->document;
+  const char* path             = zathura_document_get_path(document);
+
+  gint64 mtime = 0;
+  gint64 size  = 0;
+  if (pdf_document->file_known == false ||
+      pdf_get_file_state(path, &mtime, &size) == false ||
+      mtime != pdf_document->file_mtime || size != pdf_document->file_size) {
+    girara_warning("The file of the document has changed, not using a copy of it");
+    return NULL;
+  }
+
+  char* file_uri = g_filename_to_uri(path, NULL, NULL);
+  if (file_uri == NULL) {
+    return NULL;
+  }
+
+  PopplerDocument* poppler_document = poppler_document_new_from_file(file_uri,
+      zathura_document_get_password(document), NULL);
+  g_free(file_uri);
+
+  if (poppler_document == NULL) {
+    return NULL;
+  }
+
+  guint8 id[PDF_DOCUMENT_ID_LENGTH];
+  const bool id_known = pdf_get_document_id(poppler_document, id);
+
+  if (poppler_document_get_n_pages(poppler_document) != (int) pdf_document->number_of_pages ||
+      id_known != pdf_document->id_known ||
+      (id_known == true && memcmp(id, pdf_document->id, PDF_DOCUMENT_ID_LENGTH) != 0)) {
+    girara_warning("The file of the document has changed, not using a copy of it");
+    g_object_unref(poppler_document);
+    return NULL;
+  }
+
+  return poppler_document;
+}
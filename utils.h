@@ -17,4 +17,62 @@
 zathura_link_t* poppler_link_to_zathura_link(PopplerDocument* poppler_document,
     PopplerAction* poppler_action, zathura_rectangle_t position);
 
+/**
+ * Name of the environment variable that enables replaying pages from
+ * recorded drawing operations
+ */
+#define PDF_DISPLAY_LIST_OPTION "ZATHURA_PDF_POPPLER_DISPLAY_LIST"
+
+/**
+ * Name of the environment variable that enables keeping rendered pages
+ */
+#define PDF_IMAGE_CACHE_OPTION "ZATHURA_PDF_POPPLER_IMAGE_CACHE"
+
+/**
+ * Checks if an option of the plugin has been enabled in the environment
+ *
+ * @param name Name of the environment variable
+ *
+ * @return true if the variable is set to anything but "0"
+ */
+bool pdf_option_enabled(const char* name);
+
+/**
+ * Reads the permanent and update ID of a PDF file
+ *
+ * @param poppler_document The poppler document
+ * @param id Buffer receiving both IDs
+ *
+ * @return true if the file has an ID
+ */
+bool pdf_get_document_id(PopplerDocument* poppler_document, guint8
+    id[PDF_DOCUMENT_ID_LENGTH]);
+
+/**
+ * Reads the modification time and size of a file
+ *
+ * @param path Path to the file
+ * @param mtime Set to the modification time in seconds
+ * @param size Set to the size in bytes
+ *
+ * @return true if the file could be read
+ */
+bool pdf_get_file_state(const char* path, gint64* mtime, gint64* size);
+
+/**
+ * Opens another copy of a document. Poppler documents must not be used from
+ * several threads at once, so every worker thread uses its own copy. The file
+ * may have been replaced since the document was opened, so the copy is only
+ * returned if the modification time and size of the file, and the number of
+ * pages and ID of the copy match those of the document. Some generators write
+ * the same ID into every version of a file, so the ID alone does not tell
+ * versions apart.
+ *
+ * @param pdf_document The document
+ *
+ * @return The poppler document or NULL if an error occurred or the file
+ *   changed
+ */
+PopplerDocument* pdf_open_poppler_document_copy(pdf_document_t* pdf_document);
+
 #endif // UTILS_H
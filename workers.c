@@ -0,0 +1,182 @@
+/* See LICENSE file for license and copyright information */
+
+#include "workers.h"
+#include "utils.h"
+
+#define WORKERS_MAX 4
+#define PAGES_PER_WORKER 2
+
+/**
+ * Result of a page waiting to be passed on
+ */
+typedef struct workers_slot_s {
+  bool ready; /**< Set once result is filled in */
+  void* result; /**< Result of the page or NULL if it failed */
+} workers_slot_t;
+
+/**
+ * State shared between the workers and the calling thread
+ */
+typedef struct workers_job_s {
+  GMutex lock; /**< Lock for all members below */
+  GCond cond; /**< Signalled whenever a slot is filled or emptied */
+  unsigned int next_page; /**< Next page to hand out to a worker */
+  unsigned int next_output; /**< Next page to pass on */
+  unsigned int last; /**< Last page */
+  workers_slot_t* slots; /**< Ring of results waiting to be passed on */
+  unsigned int window; /**< Number of slots */
+  bool cancelled; /**< Set to stop the workers */
+  pdf_workers_process_t process; /**< Function processing a page */
+  void* data; /**< Custom data passed to process */
+} workers_job_t;
+
+/**
+ * A worker with its own copy of the document
+ */
+typedef struct workers_worker_s {
+  workers_job_t* job; /**< The job */
+  PopplerDocument* poppler_document; /**< Document used by this worker */
+  GThread* thread; /**< The thread */
+} workers_worker_t;
+
+static gpointer worker_thread(gpointer data);
+
+zathura_error_t
+pdf_workers_run(pdf_document_t* pdf_document, const char* name, unsigned int
+    first, unsigned int last, pdf_workers_process_t process,
+    pdf_workers_output_t output, GDestroyNotify result_free, void* data)
+{
+  if (pdf_document == NULL || process == NULL || output == NULL ||
+      result_free == NULL || first > last || last >= pdf_document->number_of_pages) {
+    return ZATHURA_ERROR_INVALID_ARGUMENTS;
+  }
+
+  const unsigned int number_of_workers = MIN(MIN(g_get_num_processors(),
+        WORKERS_MAX), last - first + 1);
+  workers_worker_t* workers = g_malloc0(sizeof(workers_worker_t) * number_of_workers);
+  unsigned int started = 0;
+
+  workers_job_t job = {
+    .next_page   = first,
+    .next_output = first,
+    .last        = last,
+    .window      = number_of_workers * PAGES_PER_WORKER,
+    .cancelled   = false,
+    .process     = process,
+    .data        = data
+  };
+  g_mutex_init(&job.lock);
+  g_cond_init(&job.cond);
+  job.slots = g_malloc0(sizeof(workers_slot_t) * job.window);
+
+  for (unsigned int i = 0; i < number_of_workers; i++) {
+    workers[started].poppler_document = pdf_open_poppler_document_copy(pdf_document);
+    if (workers[started].poppler_document == NULL) {
+      break;
+    }
+
+    workers[started].job    = &job;
+    workers[started].thread = g_thread_new(name, worker_thread, &workers[started]);
+    started++;
+  }
+
+  zathura_error_t error = ZATHURA_ERROR_OK;
+  for (unsigned int i = first; i <= last; i++) {
+    void* result = NULL;
+
+    if (started == 0) {
+      /* no copy of the document could be opened, process the pages one by
+       * one */
+      pdf_document_lock(pdf_document);
+      result = process(pdf_document->poppler_document, i, data);
+      pdf_document_unlock(pdf_document);
+    } else {
+      g_mutex_lock(&job.lock);
+      while (job.slots[i % job.window].ready == false) {
+        g_cond_wait(&job.cond, &job.lock);
+      }
+      result = job.slots[i % job.window].result;
+      job.slots[i % job.window] = (workers_slot_t) { false, NULL };
+      job.next_output = i + 1;
+      g_cond_broadcast(&job.cond);
+      g_mutex_unlock(&job.lock);
+    }
+
+    if (result == NULL) {
+      error = ZATHURA_ERROR_UNKNOWN;
+      break;
+    }
+
+    const bool next = output(i, result, data);
+    result_free(result);
+
+    if (next == false) {
+      error = ZATHURA_ERROR_UNKNOWN;
+      break;
+    }
+  }
+
+  /* stop the workers in case a page failed */
+  g_mutex_lock(&job.lock);
+  job.cancelled = true;
+  g_cond_broadcast(&job.cond);
+  g_mutex_unlock(&job.lock);
+
+  for (unsigned int i = 0; i < started; i++) {
+    g_thread_join(workers[i].thread);
+    g_object_unref(workers[i].poppler_document);
+  }
+
+  for (unsigned int i = 0; i < job.window; i++) {
+    if (job.slots[i].result != NULL) {
+      result_free(job.slots[i].result);
+    }
+  }
+
+  g_free(job.slots);
+  g_cond_clear(&job.cond);
+  g_mutex_clear(&job.lock);
+  g_free(workers);
+
+  return error;
+}
+
+static gpointer
+worker_thread(gpointer data)
+{
+  workers_worker_t* worker = data;
+  workers_job_t* job       = worker->job;
+
+  g_mutex_lock(&job->lock);
+
+  while (true) {
+    /* the number of results waiting to be passed on is bounded by the
+     * window */
+    while (job->cancelled == false && job->next_page <= job->last &&
+        job->next_page >= job->next_output + job->window) {
+      g_cond_wait(&job->cond, &job->lock);
+    }
+
+    if (job->cancelled == true || job->next_page > job->last) {
+      break;
+    }
+
+    const unsigned int index = job->next_page++;
+    g_mutex_unlock(&job->lock);
+
+    void* result = job->process(worker->poppler_document, index, job->data);
+
+    g_mutex_lock(&job->lock);
+    job->slots[index % job->window] = (workers_slot_t) { true, result };
+    g_cond_broadcast(&job->cond);
+
+    /* a failed page ends the job, the pages after it are not needed */
+    if (result == NULL) {
+      break;
+    }
+  }
+
+  g_mutex_unlock(&job->lock);
+
+  return NULL;
+}
@@ -0,0 +1,53 @@
+/* See LICENSE file for license and copyright information */
+
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include "plugin.h"
+
+/**
+ * Processes a page. Runs on a worker thread with the copy of the document of
+ * the worker, or on the calling thread with the document locked.
+ *
+ * @param poppler_document Document to load the page from
+ * @param index Page index
+ * @param data Custom data
+ * @return Result of the page or NULL if it could not be processed
+ */
+typedef void* (*pdf_workers_process_t)(PopplerDocument* poppler_document,
+    unsigned int index, void* data);
+
+/**
+ * Receives the result of a page on the calling thread. Results arrive in
+ * page order.
+ *
+ * @param index Page index
+ * @param result Result of the page, freed after the call
+ * @param data Custom data
+ * @return true to continue, false to stop
+ */
+typedef bool (*pdf_workers_output_t)(unsigned int index, void* result,
+    void* data);
+
+/**
+ * Processes a range of pages on worker threads and passes the results on in
+ * page order. Every worker uses its own copy of the document, and only a few
+ * results per worker wait to be passed on. If no copy can be opened, the
+ * pages are processed one by one with the document locked.
+ *
+ * @param pdf_document The document
+ * @param name Name of the worker threads
+ * @param first Index of the first page
+ * @param last Index of the last page
+ * @param process Function processing a page
+ * @param output Function receiving the results
+ * @param result_free Function freeing a result
+ * @param data Custom data passed to process and output
+ * @return ZATHURA_ERROR_OK when every page has been passed on,
+ *   ZATHURA_ERROR_UNKNOWN if a page could not be processed or output stopped
+ */
+zathura_error_t pdf_workers_run(pdf_document_t* pdf_document, const char*
+    name, unsigned int first, unsigned int last, pdf_workers_process_t process,
+    pdf_workers_output_t output, GDestroyNotify result_free, void* data);
+
+#endif // WORKERS_H